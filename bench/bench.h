@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <utility>
+#include <sys/resource.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace bench {
+
+/// \brief wall time and memory touched by one measured run
+struct result {
+  double seconds;
+  long minor_faults;  ///< pages touched for the first time
+};
+
+inline long minor_faults() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_minflt;
+}
+
+template<typename F>
+result measure(F&& f) {
+  long faults = minor_faults();
+  auto begin = std::chrono::steady_clock::now();
+  std::forward<F>(f)();
+  auto end = std::chrono::steady_clock::now();
+  return {std::chrono::duration<double>(end - begin).count(), minor_faults() - faults};
+}
+
+inline void report(const char* name, const result& r) {
+  std::printf("%-56s %10.3f ms %10ld pages\n", name, r.seconds * 1e3, r.minor_faults);
+}
+
+/// \brief keep the optimizer from discarding a computed value
+template<typename T>
+void do_not_optimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/// \brief peak resident set size in KiB of `f` run in a child process
+///
+/// The parent's own high-water mark does not leak into the figure, so
+/// several configurations can be compared within one program.
+template<typename F>
+long peak_rss_kb(F&& f) {
+#ifdef __GLIBC__
+  malloc_trim(0);
+#endif
+  pid_t pid = fork();
+  if (pid == 0) {
+    std::forward<F>(f)();
+    _exit(0);
+  }
+  int status = 0;
+  rusage usage{};
+  wait4(pid, &status, 0, &usage);
+  return usage.ru_maxrss;
+}
+
+/// \brief allocation counts shared by all counting_allocator instances
+struct allocation_stats {
+  std::size_t allocations = 0;
+  std::size_t live_bytes = 0;
+  std::size_t peak_bytes = 0;
+
+  static allocation_stats& get() {
+    static allocation_stats stats;
+    return stats;
+  }
+};
+
+/// \brief std::allocator which records its traffic in allocation_stats
+template<typename T>
+struct counting_allocator : std::allocator<T> {
+  using value_type = T;
+
+  template<typename U>
+  struct rebind { using other = counting_allocator<U>; };
+
+  counting_allocator() = default;
+
+  template<typename U>
+  counting_allocator(const counting_allocator<U>&) noexcept { }
+
+  T* allocate(std::size_t n) {
+    auto& stats = allocation_stats::get();
+    stats.allocations++;
+    stats.live_bytes += n * sizeof(T);
+    stats.peak_bytes = std::max(stats.peak_bytes, stats.live_bytes);
+    return std::allocator<T>::allocate(n);
+  }
+
+  void deallocate(T* p, std::size_t n) {
+    allocation_stats::get().live_bytes -= n * sizeof(T);
+    std::allocator<T>::deallocate(p, n);
+  }
+};
+
+}
@@ -0,0 +1,72 @@
+//
+// Random-position edit traces on a 64 MiB document: flat gap_buffer against
+// chunked_gap_buffer.
+//
+
+#include <random>
+#include <string>
+#include "bench.h"
+#include "chunked_gap_buffer.h"
+#include "gap_buffer.h"
+
+namespace {
+
+constexpr std::size_t document_size = std::size_t(64) << 20;
+constexpr int edits = 5000;
+
+template<typename Buffer>
+Buffer make_document() {
+  std::string chunk(1 << 20, 'x');
+  Buffer buffer;
+  for (std::size_t i = 0; i < document_size; i += chunk.size()) buffer.append(chunk.begin(), chunk.end());
+  return buffer;
+}
+
+/// \brief type a few characters or delete a few at uniformly random places
+template<typename Buffer>
+void random_edits(Buffer& buffer) {
+  std::mt19937 rng(1);
+  std::string word("hello");
+  for (int i = 0; i < edits; ++i) {
+    auto pos = std::uniform_int_distribution<std::size_t>(0, buffer.size() - 8)(rng);
+    if (i % 2) buffer.insert(buffer.begin() + pos, word.begin(), word.end());
+    else buffer.erase(buffer.begin() + pos, buffer.begin() + pos + 5);
+  }
+}
+
+/// \brief edit in bursts around a handful of far-apart cursors
+template<typename Buffer>
+void cursor_hopping(Buffer& buffer) {
+  std::mt19937 rng(2);
+  std::size_t cursors[4];
+  for (auto& c : cursors) c = std::uniform_int_distribution<std::size_t>(0, buffer.size() / 2)(rng);
+  for (int i = 0; i < edits; ++i) {
+    auto& c = cursors[i / 10 % 4];
+    buffer.insert(buffer.begin() + c, 'y');
+    ++c;
+  }
+}
+
+template<typename Buffer>
+void random_reads(const Buffer& buffer) {
+  std::mt19937 rng(3);
+  std::size_t sum = 0;
+  for (int i = 0; i < 1000000; ++i)
+    sum += buffer[std::uniform_int_distribution<std::size_t>(0, buffer.size() - 1)(rng)];
+  bench::do_not_optimize(sum);
+}
+
+template<typename Buffer>
+void run(const std::string& name) {
+  auto buffer = make_document<Buffer>();
+  bench::report((name + " random edits").c_str(), bench::measure([&] { random_edits(buffer); }));
+  bench::report((name + " hopping between 4 cursors").c_str(), bench::measure([&] { cursor_hopping(buffer); }));
+  bench::report((name + " 10^6 random reads").c_str(), bench::measure([&] { random_reads(buffer); }));
+}
+
+}
+
+int main() {
+  run<dr::gap_buffer<char>>("gap_buffer:");
+  run<dr::chunked_gap_buffer<char>>("chunked_gap_buffer:");
+}
@@ -0,0 +1,100 @@
+//
+// Reads per second from 1 to 2 * cores reader threads while a writer keeps
+// editing a 16 MiB buffer: a gap_buffer behind a mutex against a
+// concurrent_buffer.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "gap_buffer.h"
+#include "concurrent_buffer.h"
+
+namespace {
+
+constexpr std::size_t buffer_size = std::size_t(16) << 20;
+constexpr std::size_t read_size = 256;
+constexpr auto run_time = std::chrono::milliseconds(500);
+
+/// \brief sum `read_size` elements starting at a random offset
+template<typename Buffer>
+unsigned read_window(const Buffer& b, std::mt19937& rng) {
+  auto first = b.begin() + rng() % (b.size() - read_size);
+  unsigned sum = 0;
+  for (std::size_t i = 0; i < read_size; ++i, ++first) sum += static_cast<unsigned char>(*first);
+  return sum;
+}
+
+/// \brief run `readers` threads, each calling the function `make_read()`
+/// gives it, and one calling `write` for run_time
+/// \return reads per second over all reader threads
+template<typename MakeRead, typename Write>
+double run(unsigned readers, MakeRead make_read, Write write) {
+  std::atomic<bool> done{false};
+  std::atomic<long> reads{0};
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < readers; ++i) {
+    threads.emplace_back([&, i] {
+      std::mt19937 rng(i);
+      auto read = make_read();
+      long n = 0;
+      while (!done.load(std::memory_order_relaxed)) {
+        bench::do_not_optimize(read(rng));
+        ++n;
+      }
+      reads += n;
+    });
+  }
+  threads.emplace_back([&] {
+    std::mt19937 rng(99);
+    while (!done.load(std::memory_order_relaxed)) write(rng);
+  });
+
+  std::this_thread::sleep_for(run_time);
+  done = true;
+  for (auto& t : threads) t.join();
+  return reads / std::chrono::duration<double>(run_time).count();
+}
+
+}
+
+int main() {
+  std::string text(buffer_size, '.');
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+  std::printf("%-8s %20s %20s\n", "readers", "mutex reads/s", "concurrent reads/s");
+  for (unsigned readers = 1; readers <= 2 * cores; readers *= 2) {
+    dr::gap_buffer<char> gb(text.begin(), text.end());
+    std::mutex m;
+    double locked = run(readers, [&] {
+      return [&](std::mt19937& rng) {
+        std::lock_guard<std::mutex> lock(m);
+        return read_window(gb, rng);
+      };
+    }, [&](std::mt19937& rng) {
+      std::lock_guard<std::mutex> lock(m);
+      gb.insert(gb.begin() + rng() % gb.size(), 'x');
+      gb.erase(gb.begin() + rng() % gb.size());
+    });
+
+    dr::concurrent_buffer<char> cb(text.begin(), text.end(), 2 * cores);
+    double lock_free = run(readers, [&] {
+      return [r = cb.make_reader()](std::mt19937& rng) { return read_window(*r.read(), rng); };
+    }, [&](std::mt19937& rng) {
+      auto& b = cb.edit();
+      b.insert(b.begin() + rng() % b.size(), 'x');
+      b.erase(b.begin() + rng() % b.size());
+      cb.publish();
+    });
+
+    std::printf("%-8u %20.0f %20.0f\n", readers, locked, lock_free);
+  }
+}
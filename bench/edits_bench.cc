@@ -0,0 +1,76 @@
+//
+// Replace-all over 10^5 matches in a 10 MB buffer: one replace() per match
+// against a single apply_edits() batch.
+//
+
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "gap_buffer.h"
+
+namespace {
+
+using buffer = dr::gap_buffer<char>;
+
+constexpr std::size_t matches = 100000;
+constexpr std::size_t stride = 100;
+
+buffer make_document() {
+  std::string line(stride, '.');
+  line.replace(40, 3, "foo");
+  buffer gb(0);
+  for (std::size_t i = 0; i < matches; ++i) gb.append(line.begin(), line.end());
+  // leave the gap at the far end from the first match, as after typing
+  gb.insert(gb.end(), '\n');
+  return gb;
+}
+
+std::vector<std::size_t> match_offsets() {
+  std::vector<std::size_t> offsets;
+  for (std::size_t i = 0; i < matches; ++i) offsets.push_back(i * stride + 40);
+  return offsets;
+}
+
+void run(const char* label, const std::string& replacement) {
+  auto offsets = match_offsets();
+
+  {
+    buffer gb = make_document();
+    auto r = bench::measure([&] {
+      // back to front, so that earlier offsets stay valid
+      for (auto it = offsets.rbegin(); it != offsets.rend(); ++it)
+        gb.replace(gb.begin() + *it, gb.begin() + *it + 3, replacement.begin(), replacement.end());
+    });
+    bench::report((std::string(label) + " replace() per match, back to front").c_str(), r);
+  }
+
+  {
+    buffer gb = make_document();
+    auto r = bench::measure([&] {
+      std::ptrdiff_t shift = 0;
+      for (auto offset : offsets) {
+        auto pos = gb.begin() + (offset + shift);
+        gb.replace(pos, pos + 3, replacement.begin(), replacement.end());
+        shift += std::ptrdiff_t(replacement.size()) - 3;
+      }
+    });
+    bench::report((std::string(label) + " replace() per match, front to back").c_str(), r);
+  }
+
+  {
+    buffer gb = make_document();
+    // built outside the measurement, like the offsets the loops above use
+    std::vector<buffer::edit> edits;
+    edits.reserve(offsets.size());
+    for (auto offset : offsets) edits.push_back({offset, 3, replacement});
+    auto r = bench::measure([&] { gb.apply_edits(edits); });
+    bench::report((std::string(label) + " apply_edits()").c_str(), r);
+  }
+}
+
+}
+
+int main() {
+  run("foo -> foobar:", "foobar");
+  run("foo -> x:", "x");
+}
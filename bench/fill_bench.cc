@@ -0,0 +1,48 @@
+//
+// Padding a buffer with 64M spaces: one bulk insert, the fill constructor
+// and resize, against inserting the spaces one at a time.
+//
+
+#include <string>
+#include "bench.h"
+#include "gap_buffer.h"
+
+namespace {
+
+constexpr std::size_t pad = std::size_t(64) << 20;
+
+}
+
+int main() {
+  std::string text(std::size_t(1) << 20, '.');
+
+  bench::report("64M single inserts in the middle", bench::measure([&] {
+    dr::gap_buffer<char> gb(text.begin(), text.end());
+    auto pos = gb.begin() + std::ptrdiff_t(text.size() / 2);
+    for (std::size_t i = 0; i < pad; ++i) pos = gb.insert(pos, ' ') + 1;
+    bench::do_not_optimize(gb.size());
+  }));
+
+  bench::report("insert(pos, 64M, ' ') in the middle", bench::measure([&] {
+    dr::gap_buffer<char> gb(text.begin(), text.end());
+    gb.insert(gb.begin() + std::ptrdiff_t(text.size() / 2), pad, ' ');
+    bench::do_not_optimize(gb.size());
+  }));
+
+  bench::report("gap_buffer(64M, ' ')", bench::measure([&] {
+    dr::gap_buffer<char> gb(pad, ' ');
+    bench::do_not_optimize(gb.size());
+  }));
+
+  bench::report("resize by 64M", bench::measure([&] {
+    dr::gap_buffer<char> gb(text.begin(), text.end());
+    gb.resize(gb.size() + pad, ' ');
+    bench::do_not_optimize(gb.size());
+  }));
+
+  bench::report("insert(pos, 1M, std::string) in the middle", bench::measure([&] {
+    dr::gap_buffer<std::string> gb(1000, std::string("line"));
+    gb.insert(gb.begin() + 500, std::size_t(1) << 20, std::string(" "));
+    bench::do_not_optimize(gb.size());
+  }));
+}
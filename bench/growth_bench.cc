@@ -0,0 +1,65 @@
+//
+// Reallocations, peak allocated bytes and peak RSS of gap_buffer under the
+// built-in growth policies.
+//
+
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "gap_buffer.h"
+
+namespace {
+
+template<template<typename> class Policy>
+using buffer = dr::gap_buffer<char, bench::counting_allocator<char>, Policy<char>>;
+
+/// \brief many short-lived buffers receiving a few keystrokes each
+template<template<typename> class Policy>
+void scratch_buffers() {
+  std::vector<buffer<Policy>> buffers(100000);
+  for (auto& gb : buffers)
+    for (int i = 0; i < 12; ++i) gb.push_back('x');
+}
+
+/// \brief a log appended to in 4 KiB records up to 512 MiB
+template<template<typename> class Policy>
+void growing_log() {
+  buffer<Policy> gb;
+  std::string record(4096, 'x');
+  for (int i = 0; i < 128 * 1024; ++i) gb.append(record.begin(), record.end());
+}
+
+/// \brief a large document mostly deleted, then edited on
+template<template<typename> class Policy>
+void large_erase() {
+  buffer<Policy> gb;
+  std::string chunk(1 << 20, 'x');
+  for (int i = 0; i < 256; ++i) gb.append(chunk.begin(), chunk.end());
+  gb.erase(gb.begin() + (1 << 20), gb.end());
+  for (int i = 0; i < 64; ++i) gb.append(chunk.begin(), chunk.begin() + 4096);
+}
+
+template<template<typename> class Policy>
+void run(const char* policy) {
+  auto workload = [&](const char* name, void (*f)()) {
+    long rss = bench::peak_rss_kb(f);
+    bench::allocation_stats::get() = {};
+    auto r = bench::measure(f);
+    auto stats = bench::allocation_stats::get();
+    std::printf("%-10s %-16s %9.1f ms %10zu allocs %10zu KiB peak alloc %10ld KiB peak RSS\n",
+                policy, name, r.seconds * 1e3, stats.allocations, stats.peak_bytes >> 10, rss);
+  };
+
+  workload("scratch", scratch_buffers<Policy>);
+  workload("growing log", growing_log<Policy>);
+  workload("large erase", large_erase<Policy>);
+}
+
+}
+
+int main() {
+  run<dr::default_growth_policy>("default");
+  run<dr::geometric_growth_policy>("geometric");
+  run<dr::compact_growth_policy>("compact");
+  run<dr::page_growth_policy>("page");
+}
@@ -0,0 +1,107 @@
+//
+// Hashing and comparing a 256 MiB gap_buffer<char> while it is being
+// edited: a content_hash kept up to date against hashing a copy of the
+// contents after each edit, and equality decided by the hashes against a
+// full comparison.
+//
+
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include "bench.h"
+#include "content_hash.h"
+#include "gap_buffer.h"
+
+namespace {
+
+using buffer = dr::gap_buffer<char>;
+
+constexpr std::size_t length = std::size_t(256) << 20;
+constexpr int edits = 200'000;
+
+/// \brief typing at a cursor which jumps every 1000 edits; `after_edit`
+/// runs after each of them
+template<typename F>
+void edit_session(buffer& gb, std::mt19937& rng, int count, F after_edit) {
+  std::size_t cursor = gb.size() / 2;
+  for (int i = 0; i < count; ++i) {
+    if (i % 1000 == 0) cursor = rng() % gb.size();
+    cursor = std::min(cursor, gb.size());
+    if (rng() % 4 == 0 && cursor > 0)
+      gb.erase(gb.begin() + --cursor);
+    else
+      gb.insert(gb.begin() + cursor++, char('a' + rng() % 26));
+    after_edit();
+  }
+}
+
+std::size_t hash_copy(const buffer& gb) {
+  std::string copy(gb.begin(), gb.end());
+  return std::hash<std::string_view>()(copy);
+}
+
+}
+
+int main() {
+  std::mt19937 rng(1);
+  buffer gb;
+  {
+    std::string text(length, ' ');
+    for (auto& c : text) c = char('a' + rng() % 26);
+    gb.append(text.begin(), text.end());
+  }
+  gb.insert(gb.begin() + gb.size() / 3, 'x');
+
+  bench::report("copy out + std::hash", bench::measure([&] {
+    bench::do_not_optimize(hash_copy(gb));
+  }));
+
+  bench::report("content_hash_of", bench::measure([&] {
+    bench::do_not_optimize(dr::content_hash_of(gb.begin(), gb.end()));
+  }));
+
+  bench::report("build content_hash", bench::measure([&] {
+    dr::content_hash<buffer> hash(gb);
+    bench::do_not_optimize(hash.value());
+  }));
+
+  bench::report("200k edits, no hash", bench::measure([&] {
+    edit_session(gb, rng, edits, [] { });
+  }));
+
+  bench::report("20 edits, copy out + std::hash after each", bench::measure([&] {
+    edit_session(gb, rng, 20, [&] { bench::do_not_optimize(hash_copy(gb)); });
+  }));
+
+  dr::content_hash<buffer> hash(gb);
+  bench::report("200k edits, content_hash value() after each", bench::measure([&] {
+    edit_session(gb, rng, edits, [&] { bench::do_not_optimize(hash.value()); });
+  }));
+
+  buffer other(gb);
+  dr::content_hash<buffer> other_hash(other);
+  other.erase(other.begin());
+  other.insert(other.begin(), 'y');
+  std::size_t middle = other.size() / 2;
+  other.insert(other.begin() + middle, 'q');
+  other.erase(other.begin() + middle);
+
+  bench::report("100 inequalities, operator== (differs at 0)", bench::measure([&] {
+    for (int i = 0; i < 100; ++i) bench::do_not_optimize(gb == other);
+  }));
+
+  bench::report("100 inequalities, content_hash::equals", bench::measure([&] {
+    for (int i = 0; i < 100; ++i) bench::do_not_optimize(hash.equals(other_hash));
+  }));
+
+  other[0] = gb[0];
+  other_hash.reset(other);
+  bench::report("equal contents, content_hash::equals", bench::measure([&] {
+    bench::do_not_optimize(hash.equals(other_hash));
+  }));
+
+  bench::report("equal contents, operator<", bench::measure([&] {
+    bench::do_not_optimize(gb < other);
+  }));
+}
@@ -0,0 +1,83 @@
+//
+// Cost per keystroke-sized edit of recording undo history: no history,
+// copying the erased text with substr() before each erase, and an
+// edit_journal.
+//
+
+#include <random>
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "gap_buffer.h"
+#include "edit_journal.h"
+
+namespace {
+
+using buffer = dr::gap_buffer<char>;
+
+constexpr int edits = 1'000'000;
+
+/// \brief typing with a backspace now and then, moving the cursor to a
+/// random place every 50 edits; `before_erase(first, last)` runs before
+/// each erase and `on_move()` on each cursor move
+template<typename F, typename G>
+void typing(buffer& gb, F before_erase, G on_move) {
+  std::mt19937 rng(9);
+  std::size_t cursor = 0;
+  for (int i = 0; i < edits; ++i) {
+    if (i % 50 == 0) {
+      cursor = rng() % gb.size();
+      on_move();
+    }
+    if (rng() % 5 == 0 && cursor > 0) {
+      --cursor;
+      before_erase(gb.cbegin() + cursor, gb.cbegin() + cursor + 1);
+      gb.erase(gb.begin() + cursor);
+    }
+    else
+      gb.insert(gb.begin() + cursor++, char('a' + i % 26));
+  }
+}
+
+}
+
+int main() {
+  std::string text(std::size_t(1) << 20, '.');
+  auto nothing = [](auto...) { };
+
+  bench::report("1M edits, no history", bench::measure([&] {
+    buffer gb(text.begin(), text.end());
+    typing(gb, nothing, nothing);
+  }));
+
+  bench::report("1M edits, substr() before each erase", bench::measure([&] {
+    buffer gb(text.begin(), text.end());
+    std::vector<buffer> erased;
+    typing(gb, [&](buffer::const_iterator f, buffer::const_iterator l) {
+      erased.push_back(gb.substr(f, l));
+    }, nothing);
+    bench::do_not_optimize(erased.size());
+  }));
+
+  bench::report("1M edits, edit_journal", bench::measure([&] {
+    buffer gb(text.begin(), text.end());
+    dr::edit_journal<buffer> journal(gb);
+    typing(gb, nothing, [&] { journal.seal(); });
+    std::printf("  journal holds %zu KiB\n", journal.memory_used() >> 10);
+  }));
+
+  bench::report("1M edits, edit_journal, never coalescing", bench::measure([&] {
+    buffer gb(text.begin(), text.end());
+    dr::edit_journal<buffer> journal(gb, dr::edit_journal<buffer>::default_memory_limit, 1);
+    typing(gb, nothing, nothing);
+    std::printf("  journal holds %zu KiB\n", journal.memory_used() >> 10);
+  }));
+
+  buffer gb(text.begin(), text.end());
+  dr::edit_journal<buffer> journal(gb);
+  typing(gb, nothing, [&] { journal.seal(); });
+  bench::report("undo and redo everything", bench::measure([&] {
+    while (journal.undo()) { }
+    while (journal.redo()) { }
+  }));
+}
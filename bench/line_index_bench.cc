@@ -0,0 +1,93 @@
+//
+// Jump-to-line on a 10M-line gap_buffer<char> while it is being edited,
+// with a line_index attached and with a scan from the start of the buffer.
+//
+
+#include <random>
+#include <string>
+#include "bench.h"
+#include "gap_buffer.h"
+#include "line_index.h"
+
+namespace {
+
+using buffer = dr::gap_buffer<char>;
+
+constexpr std::size_t line_count = 10'000'000;
+constexpr int edits = 200'000;
+
+/// \brief offset of `line` found by walking the line feeds from the start
+std::size_t scan_to_line(const buffer& gb, std::size_t line) {
+  auto it = gb.cbegin();
+  for (; line > 0; --line) it = dr::find(it, gb.cend(), '\n') + 1;
+  return it - gb.cbegin();
+}
+
+/// \brief typing near a cursor which jumps to a random line every 1000
+/// edits, one offset_to_line and one line_to_offset per edit
+template<typename Index>
+void edit_session(buffer& gb, Index* index, std::mt19937& rng) {
+  std::size_t cursor = gb.size() / 2;
+  const std::string typed[] = {"x", "yz", "\n", "word "};
+  for (int i = 0; i < edits; ++i) {
+    if (i % 1000 == 0)
+      cursor = index ? index->line_to_offset(rng() % index->line_count()) : rng() % gb.size();
+    cursor = std::min(cursor, gb.size());
+
+    if (rng() % 4 == 0 && cursor > 0) {
+      gb.erase(gb.begin() + (cursor - 1));
+      --cursor;
+    }
+    else {
+      const std::string& s = typed[rng() % 4];
+      gb.insert(gb.begin() + cursor, s.begin(), s.end());
+      cursor += s.size();
+    }
+
+    if (index) {
+      auto line = index->offset_to_line(cursor);
+      bench::do_not_optimize(index->line_to_offset(line));
+    }
+  }
+}
+
+}
+
+int main() {
+  buffer gb;
+  {
+    std::string text;
+    std::mt19937 rng(7);
+    for (std::size_t i = 0; i < line_count; ++i) {
+      text.append(rng() % 40, 'a');
+      text.push_back('\n');
+    }
+    gb.append(text.begin(), text.end());
+  }
+  std::printf("%zu MiB, %zu lines\n", gb.size() >> 20, line_count);
+
+  std::mt19937 rng(1);
+  bench::report("build line_index", bench::measure([&] {
+    dr::line_index<buffer> index(gb);
+    bench::do_not_optimize(index.line_count());
+  }));
+
+  bench::report("200k edits, no index", bench::measure([&] {
+    edit_session<dr::line_index<buffer>>(gb, nullptr, rng);
+  }));
+
+  dr::line_index<buffer> index(gb);
+  bench::report("200k edits + 400k line lookups, with index", bench::measure([&] {
+    edit_session(gb, &index, rng);
+  }));
+
+  bench::report("100k random jumps, line_to_offset", bench::measure([&] {
+    for (int i = 0; i < 100'000; ++i)
+      bench::do_not_optimize(index.line_to_offset(rng() % index.line_count()));
+  }));
+
+  bench::report("100 random jumps, scanning from the start", bench::measure([&] {
+    for (int i = 0; i < 100; ++i)
+      bench::do_not_optimize(scan_to_line(gb, rng() % index.line_count()));
+  }));
+}
@@ -0,0 +1,79 @@
+//
+// Keeping 50k markers in place through typing and deleting in a 10 MiB
+// gap_buffer<char>: marker_set against fixing up a plain list of offsets
+// after every edit.
+//
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "gap_buffer.h"
+#include "marker_set.h"
+
+namespace {
+
+using buffer = dr::gap_buffer<char>;
+
+constexpr std::size_t buffer_size = std::size_t(10) << 20;
+constexpr std::size_t marker_count = 50'000;
+
+/// \brief typing and deleting at a cursor which jumps to a random offset
+/// every 1000 edits; `on_edit(offset, inserted, erased)` runs after each
+template<typename F>
+void edit_session(buffer& gb, int edits, F on_edit) {
+  std::mt19937 rng(3);
+  std::size_t cursor = 0;
+  for (int i = 0; i < edits; ++i) {
+    if (i % 1000 == 0) cursor = rng() % gb.size();
+    if (rng() % 4 == 0 && cursor > 0) {
+      --cursor;
+      gb.erase(gb.begin() + cursor);
+      on_edit(cursor, 0, 1);
+    }
+    else {
+      gb.insert(gb.begin() + cursor, 'x');
+      on_edit(cursor, 1, 0);
+      ++cursor;
+    }
+  }
+}
+
+}
+
+int main() {
+  std::vector<std::size_t> offsets;
+  std::mt19937 rng(5);
+  for (std::size_t i = 0; i < marker_count; ++i) offsets.push_back(rng() % buffer_size);
+
+  std::string text(buffer_size, '.');
+
+  bench::report("200k edits, no markers", bench::measure([&] {
+    buffer gb(text.begin(), text.end());
+    edit_session(gb, 200'000, [](std::size_t, std::size_t, std::size_t) { });
+  }));
+
+  bench::report("20k edits, 50k offsets fixed up one by one", bench::measure([&] {
+    buffer gb(text.begin(), text.end());
+    std::vector<std::size_t> markers = offsets;
+    edit_session(gb, 20'000, [&](std::size_t at, std::size_t inserted, std::size_t erased) {
+      for (auto& m : markers) {
+        if (m > at) m = m + inserted - std::min(erased, m - at);
+      }
+    });
+    bench::do_not_optimize(markers.data());
+  }));
+
+  buffer gb(text.begin(), text.end());
+  dr::marker_set<buffer> markers(gb);
+  std::sort(offsets.begin(), offsets.end());
+  bench::report("create 50k markers in position order", bench::measure([&] {
+    for (auto offset : offsets) markers.create(offset);
+  }));
+
+  bench::report("200k edits, 50k markers in a marker_set", bench::measure([&] {
+    edit_session(gb, 200'000, [](std::size_t, std::size_t, std::size_t) { });
+    bench::do_not_optimize(markers.position(0));
+  }));
+}
@@ -0,0 +1,68 @@
+//
+// Growth-heavy traces on gap_buffer<char> backed by std::allocator and by
+// mmap_allocator, which grows with mremap instead of copying.
+//
+
+#include <random>
+#include <string>
+#include "bench.h"
+#include "gap_buffer.h"
+#include "mmap_allocator.h"
+
+namespace {
+
+template<typename Allocator>
+using buffer = dr::gap_buffer<char, Allocator, dr::default_growth_policy<char>>;
+
+constexpr std::size_t target_size = std::size_t(1) << 30;
+
+/// \brief append 64 KiB records until the buffer holds 1 GiB
+template<typename Allocator>
+void append_trace() {
+  buffer<Allocator> gb;
+  std::string record(64 << 10, 'x');
+  while (gb.size() < target_size) gb.append(record.begin(), record.end());
+  bench::do_not_optimize(gb.size());
+}
+
+/// \brief paste 1 MiB at random positions until the buffer holds 256 MiB
+template<typename Allocator>
+void paste_trace() {
+  buffer<Allocator> gb;
+  std::string record(1 << 20, 'x');
+  std::mt19937 rng(42);
+  while (gb.size() < target_size / 4) {
+    auto pos = std::uniform_int_distribution<std::size_t>(0, gb.size())(rng);
+    gb.insert(gb.begin() + pos, record.begin(), record.end());
+  }
+  bench::do_not_optimize(gb.size());
+}
+
+/// \brief grow to 1 GiB, delete almost everything and grow again
+template<typename Allocator>
+void erase_and_regrow_trace() {
+  buffer<Allocator> gb;
+  std::string record(64 << 10, 'x');
+  for (int round = 0; round < 2; ++round) {
+    while (gb.size() < target_size) gb.append(record.begin(), record.end());
+    gb.erase(gb.begin() + 4096, gb.end());
+  }
+  bench::do_not_optimize(gb.size());
+}
+
+template<typename Allocator>
+void run(const char* name) {
+  bench::report((std::string(name) + " append to 1G").c_str(), bench::measure(append_trace<Allocator>));
+  bench::report((std::string(name) + " random paste to 256M").c_str(), bench::measure(paste_trace<Allocator>));
+  bench::report((std::string(name) + " erase and regrow").c_str(), bench::measure(erase_and_regrow_trace<Allocator>));
+  std::printf("%-56s %10ld KiB peak RSS\n", (std::string(name) + " erase and regrow").c_str(),
+              bench::peak_rss_kb(erase_and_regrow_trace<Allocator>));
+}
+
+}
+
+int main() {
+  run<std::allocator<char>>("std::allocator:");
+  run<dr::mmap_allocator<char>>("mmap_allocator:");
+  run<dr::mmap_allocator<char, true>>("mmap_allocator with huge pages:");
+}
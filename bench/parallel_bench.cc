@@ -0,0 +1,65 @@
+//
+// Whole-buffer passes over a gap_buffer with the gap in the middle: the
+// segmented algorithms against their parallel versions on all cores.
+// The size in MiB is the first argument, 256 by default.
+//
+
+#include <cctype>
+#include <cstdlib>
+#include <string>
+#include "bench.h"
+#include "gap_buffer.h"
+#include "parallel_algorithm.h"
+
+int main(int argc, char** argv) {
+  std::size_t size = std::size_t(argc > 1 ? std::atol(argv[1]) : 256) << 20;
+  std::string text(size, 'a');
+  for (std::size_t i = 0; i < size; i += 61) text[i] = '\n';
+
+  dr::gap_buffer<char> gb(text.begin(), text.end());
+  gb.insert(gb.begin() + std::ptrdiff_t(size / 2), 'x');
+  dr::gap_buffer<char> other(gb);
+  auto& pool = dr::thread_pool::shared();
+  std::printf("%u threads\n", pool.size());
+
+  auto upper = [](char c) { return char(std::toupper(static_cast<unsigned char>(c))); };
+
+  bench::report("count, serial", bench::measure([&] {
+    bench::do_not_optimize(dr::count(gb.begin(), gb.end(), '\n'));
+  }));
+  bench::report("count, parallel", bench::measure([&] {
+    bench::do_not_optimize(dr::parallel::count(gb.begin(), gb.end(), '\n'));
+  }));
+
+  bench::report("toupper in place, serial", bench::measure([&] {
+    auto[front, back] = gb.segments();
+    std::transform(front.begin(), front.end(), front.begin(), upper);
+    std::transform(back.begin(), back.end(), back.begin(), upper);
+  }));
+  bench::report("toupper in place, parallel", bench::measure([&] {
+    dr::parallel::transform(gb.begin(), gb.end(), gb.begin(), upper);
+  }));
+
+  bench::report("hash, parallel", bench::measure([&] {
+    bench::do_not_optimize(dr::parallel::hash(gb.begin(), gb.end()));
+  }));
+  bench::report("hash, one thread", bench::measure([&] {
+    dr::thread_pool single(1);
+    bench::do_not_optimize(dr::parallel::hash(gb.begin(), gb.end(), single));
+  }));
+
+  other = gb;
+  bench::report("operator ==", bench::measure([&] {
+    bench::do_not_optimize(gb == other);
+  }));
+  bench::report("parallel::equal", bench::measure([&] {
+    bench::do_not_optimize(dr::parallel::equal(gb, other));
+  }));
+
+  bench::report("substr of the whole buffer", bench::measure([&] {
+    bench::do_not_optimize(gb.substr(gb.cbegin(), gb.cend()).size());
+  }));
+  bench::report("parallel::substr of the whole buffer", bench::measure([&] {
+    bench::do_not_optimize(dr::parallel::substr(gb, gb.cbegin(), gb.cend()).size());
+  }));
+}
@@ -0,0 +1,131 @@
+//
+// Per-request allocation cost of short-lived gap_buffers. A request opens
+// a thousand buffers, types into them a few characters at a time until
+// they hold 50 to 4000 bytes, edits them and drops them all. The request
+// is served with std::allocator and with dr::pmr::gap_buffer on several
+// memory resources; a counting upstream resource shows how often each of
+// them goes to the system allocator.
+//
+
+#include <cstdio>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "gap_buffer.h"
+#include "gap_buffer_arena.h"
+
+namespace {
+
+constexpr int requests = 1000;
+constexpr int buffers_per_request = 1000;
+
+/// \brief new_delete_resource counting the calls it receives
+struct counting_resource : std::pmr::memory_resource {
+  std::size_t allocations = 0;
+
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    ++allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+/// \brief one request; `make()` creates an empty buffer
+template<typename Make>
+std::size_t request(std::mt19937& rng, Make make) {
+  using buffer = decltype(make());
+  static const std::string text = "the quick brown fox jumps over the lazy dog ";
+
+  std::vector<buffer> buffers;
+  buffers.reserve(buffers_per_request);
+  std::size_t total = 0;
+  for (int i = 0; i < buffers_per_request; ++i) {
+    buffer& gb = buffers.emplace_back(make());
+    std::size_t length = 50 + rng() % 3950;
+    while (gb.size() < length) {
+      std::size_t n = 1 + rng() % 16;
+      gb.insert(gb.end(), text.begin(), text.begin() + std::ptrdiff_t(n));
+    }
+    gb.insert(gb.begin() + std::ptrdiff_t(gb.size() / 2), text.begin(), text.end());
+    gb.erase(gb.begin(), gb.begin() + 10);
+    total += gb.size();
+
+    // about a third of the buffers are dropped before the request ends
+    if (rng() % 3 == 0) buffers.pop_back();
+  }
+  return total;
+}
+
+template<typename Run>
+void run(const char* name, counting_resource* upstream, Run run_request) {
+  std::mt19937 rng(1);
+  std::size_t total = 0;
+  std::size_t before = upstream ? upstream->allocations : 0;
+  auto r = bench::measure([&] {
+    for (int i = 0; i < requests; ++i) total += run_request(rng);
+  });
+  bench::do_not_optimize(total);
+
+  std::printf("%-40s %9.1f us/request", name, r.seconds * 1e6 / requests);
+  if (upstream)
+    std::printf(" %10.1f upstream allocations/request", double(upstream->allocations - before) / requests);
+  std::printf("\n");
+}
+
+}
+
+int main() {
+  using pmr_buffer = dr::pmr::gap_buffer<char>;
+
+  run("std::allocator", nullptr, [](std::mt19937& rng) {
+    return request(rng, [] { return dr::gap_buffer<char>(); });
+  });
+
+  {
+    counting_resource upstream;
+    run("new_delete_resource", &upstream, [&](std::mt19937& rng) {
+      return request(rng, [&] { return pmr_buffer(&upstream); });
+    });
+  }
+
+  {
+    counting_resource upstream;
+    std::pmr::unsynchronized_pool_resource pool(&upstream);
+    run("unsynchronized_pool_resource", &upstream, [&](std::mt19937& rng) {
+      return request(rng, [&] { return pmr_buffer(&pool); });
+    });
+  }
+
+  {
+    counting_resource upstream;
+    run("monotonic_buffer_resource per request", &upstream, [&](std::mt19937& rng) {
+      std::pmr::monotonic_buffer_resource monotonic(std::size_t(64) << 10, &upstream);
+      return request(rng, [&] { return pmr_buffer(&monotonic); });
+    });
+  }
+
+  {
+    counting_resource upstream;
+    dr::pmr::gap_buffer_arena arena(&upstream);
+    run("gap_buffer_arena, released per request", &upstream, [&](std::mt19937& rng) {
+      std::size_t total = request(rng, [&] { return pmr_buffer(&arena); });
+      arena.release();
+      return total;
+    });
+  }
+
+  {
+    counting_resource upstream;
+    dr::pmr::gap_buffer_arena arena(&upstream);
+    run("gap_buffer_arena, kept across requests", &upstream, [&](std::mt19937& rng) {
+      return request(rng, [&] { return pmr_buffer(&arena); });
+    });
+  }
+}
@@ -0,0 +1,128 @@
+//
+// Newline counting and searching over a large gap_buffer<char>: the
+// iterator loop, the segmented algorithms on each kernel, std on the raw
+// segments, and the preprocessed pattern and keyword searchers.
+//
+// Usage: search_bench [size in MiB, default 1024]
+//
+
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "gap_buffer.h"
+#include "segmented_search.h"
+
+namespace {
+
+const char* name(dr::simd::isa level) {
+  switch (level) {
+  case dr::simd::isa::avx2: return "avx2";
+  case dr::simd::isa::sse2: return "sse2";
+  default: return "scalar";
+  }
+}
+
+}
+
+int main(int argc, char** argv) {
+  std::size_t size = std::size_t(argc > 1 ? std::atol(argv[1]) : 1024) << 20;
+
+  // lines of 0 to 120 characters, with the gap in the middle
+  dr::gap_buffer<char> gb;
+  {
+    std::string text;
+    std::mt19937 rng(42);
+    while (text.size() < size) {
+      text.append(rng() % 121, 'a' + char(rng() % 26));
+      text.push_back('\n');
+    }
+    gb.append(text.begin(), text.end());
+    gb.insert(gb.begin() + gb.size() / 2, 'x');
+  }
+  std::printf("%zu MiB, best kernels: %s\n", gb.size() >> 20, name(dr::simd::best_isa()));
+
+  bench::report("count '\\n', const_iterator loop", bench::measure([&] {
+    std::ptrdiff_t n = 0;
+    for (auto it = gb.cbegin(); it != gb.cend(); ++it) n += *it == '\n';
+    bench::do_not_optimize(n);
+  }));
+
+  auto[front, back] = gb.segments();
+  bench::report("count '\\n', std::count on segments", bench::measure([&] {
+    auto n = std::count(front.begin(), front.end(), '\n') + std::count(back.begin(), back.end(), '\n');
+    bench::do_not_optimize(n);
+  }));
+
+  for (auto level : {dr::simd::isa::scalar, dr::simd::isa::sse2, dr::simd::isa::avx2}) {
+    if (level > dr::simd::best_isa()) break;
+    const auto& k = dr::simd::kernels(level);
+    auto run = [&](const char* what, auto f) {
+      auto label = std::string(what) + ", " + name(level) + " kernel";
+      bench::report(label.c_str(), bench::measure(f));
+    };
+    auto bytes = [](auto span) { return reinterpret_cast<const unsigned char*>(span.data()); };
+
+    run("count '\\n'", [&] {
+      auto n = k.count(bytes(front), bytes(front) + front.size(), '\n')
+               + k.count(bytes(back), bytes(back) + back.size(), '\n');
+      bench::do_not_optimize(n);
+    });
+    run("find absent byte", [&] {
+      auto p = k.find(bytes(front), bytes(front) + front.size(), '#');
+      auto q = k.find(bytes(back), bytes(back) + back.size(), '#');
+      bench::do_not_optimize(p);
+      bench::do_not_optimize(q);
+    });
+    run("find_first_of 4 absent bytes", [&] {
+      const unsigned char set[] = {'#', '$', '%', '&'};
+      auto p = k.find_first_of(bytes(front), bytes(front) + front.size(), set, 4);
+      auto q = k.find_first_of(bytes(back), bytes(back) + back.size(), set, 4);
+      bench::do_not_optimize(p);
+      bench::do_not_optimize(q);
+    });
+    run("search 8-byte string", [&] {
+      const unsigned char needle[] = "aaaaaaab";
+      auto p = k.search(bytes(front), bytes(front) + front.size(), needle, 8);
+      auto q = k.search(bytes(back), bytes(back) + back.size(), needle, 8);
+      bench::do_not_optimize(p);
+      bench::do_not_optimize(q);
+    });
+  }
+
+  bench::report("count '\\n', dr::count", bench::measure([&] {
+    bench::do_not_optimize(dr::count(gb.cbegin(), gb.cend(), '\n'));
+  }));
+
+  // absent patterns, so every search runs to the end
+  std::string word = "abcdefghijklmnop";
+  bench::report("search 16-byte string, substr + std::search", bench::measure([&] {
+    auto copy = gb.substr(gb.cbegin(), gb.cend());
+    auto view = copy.contiguous_view();
+    bench::do_not_optimize(std::search(view.begin(), view.end(), word.begin(), word.end()));
+  }));
+  bench::report("search 16-byte string, dr::search", bench::measure([&] {
+    bench::do_not_optimize(dr::search(gb.cbegin(), gb.cend(), word.begin(), word.end()));
+  }));
+  dr::pattern_searcher<char> pattern(word.begin(), word.end());
+  bench::report("search 16-byte string, pattern_searcher", bench::measure([&] {
+    bench::do_not_optimize(dr::search(gb.cbegin(), gb.cend(), pattern));
+  }));
+
+  for (std::size_t n : {8, 32}) {
+    // absent keywords, starting with only a handful of distinct bytes
+    std::vector<std::string> keywords;
+    for (std::size_t i = 0; i < n; ++i) keywords.push_back(std::string(1, char('a' + i % 4)) + "#" + std::to_string(i));
+
+    auto label = "search " + std::to_string(n) + " keywords, dr::search each";
+    bench::report(label.c_str(), bench::measure([&] {
+      for (const auto& k : keywords) bench::do_not_optimize(dr::search(gb.cbegin(), gb.cend(), k.begin(), k.end()));
+    }));
+    dr::keyword_searcher<char> aho_corasick(keywords);
+    label = "search " + std::to_string(n) + " keywords, keyword_searcher";
+    bench::report(label.c_str(), bench::measure([&] {
+      bench::do_not_optimize(dr::search(gb.cbegin(), gb.cend(), aho_corasick));
+    }));
+  }
+}
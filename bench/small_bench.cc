@@ -0,0 +1,48 @@
+//
+// Allocations and time for many short buffers, with and without inline
+// storage.
+//
+
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "gap_buffer.h"
+
+namespace {
+
+template<std::size_t N>
+using buffer = dr::small_gap_buffer<char, N, bench::counting_allocator<char>>;
+
+/// \brief single-line fields: fill, edit in the middle, then scan
+template<std::size_t N>
+void fields() {
+  std::vector<buffer<N>> buffers(200000);
+  for (std::size_t i = 0; i < buffers.size(); ++i) {
+    auto& gb = buffers[i];
+    for (int j = 0; j < 10 + int(i % 12); ++j) gb.push_back(char('a' + j));
+    gb.insert(gb.begin() + 3, '-');
+    gb.erase(gb.begin() + 5);
+  }
+
+  std::size_t total = 0;
+  for (const auto& gb : buffers)
+    for (char c : gb) total += c;
+  bench::do_not_optimize(total);
+}
+
+template<std::size_t N>
+void run(const char* name) {
+  bench::allocation_stats::get() = {};
+  auto r = bench::measure(fields<N>);
+  auto stats = bench::allocation_stats::get();
+  std::printf("%-24s %9.1f ms %10zu allocs %10zu KiB peak alloc\n",
+              name, r.seconds * 1e3, stats.allocations, stats.peak_bytes >> 10);
+}
+
+}
+
+int main() {
+  run<0>("gap_buffer");
+  run<16>("small_gap_buffer<16>");
+  run<24>("small_gap_buffer<24>");
+}
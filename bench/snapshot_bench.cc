@@ -0,0 +1,56 @@
+//
+// Handing a consistent copy of a 64 MiB buffer to a reader after every
+// edit: copying a gap_buffer against a chunked_gap_buffer snapshot.
+//
+
+#include <memory>
+#include <random>
+#include <string>
+#include "bench.h"
+#include "gap_buffer.h"
+#include "chunked_gap_buffer.h"
+
+namespace {
+
+constexpr std::size_t buffer_size = std::size_t(64) << 20;
+
+/// \brief `edits` single-character inserts at random places, each followed
+/// by `after_edit()`
+template<typename Buffer, typename F>
+void edit(Buffer& b, int edits, F after_edit) {
+  std::mt19937 rng(11);
+  for (int i = 0; i < edits; ++i) {
+    b.insert(b.begin() + rng() % b.size(), 'x');
+    after_edit();
+  }
+}
+
+}
+
+int main() {
+  std::string text(buffer_size, '.');
+
+  bench::report("20 edits + gap_buffer copies", bench::measure([&] {
+    dr::gap_buffer<char> gb(text.begin(), text.end());
+    edit(gb, 20, [&] {
+      auto copy = std::make_shared<const dr::gap_buffer<char>>(gb);
+      bench::do_not_optimize(copy->size());
+    });
+  }));
+
+  dr::chunked_gap_buffer<char> cb(text.begin(), text.end());
+  bench::report("10k edits, chunked_gap_buffer", bench::measure([&] {
+    edit(cb, 10'000, [] { });
+  }));
+
+  bench::report("10k edits + snapshots, chunked_gap_buffer", bench::measure([&] {
+    std::shared_ptr<const dr::chunked_gap_buffer<char>> snapshot;
+    edit(cb, 10'000, [&] { snapshot = cb.snapshot(); });
+  }));
+
+  bench::report("10k edits, 100 snapshots kept alive", bench::measure([&] {
+    std::vector<std::shared_ptr<const dr::chunked_gap_buffer<char>>> kept;
+    int i = 0;
+    edit(cb, 10'000, [&] { if (i++ % 100 == 0) kept.push_back(cb.snapshot()); });
+  }));
+}
@@ -0,0 +1,55 @@
+//
+// Bytes touched by gap_buffer storage management, comparing trivially
+// copyable elements, which are moved with memmove, against a type of the
+// same size which is moved element by element.
+//
+
+#include <string>
+#include "bench.h"
+#include "gap_buffer.h"
+
+namespace {
+
+/// \brief a char that is not trivially copyable
+struct boxed_char {
+  char c = 0;
+
+  boxed_char() = default;
+  boxed_char(char c) : c(c) { }
+  boxed_char(const boxed_char& other) : c(other.c) { }
+  boxed_char& operator =(const boxed_char& other) { c = other.c; return *this; }
+};
+
+constexpr std::size_t buffer_size = std::size_t(256) << 20;
+constexpr std::size_t chunk_size = std::size_t(1) << 20;
+
+template<typename T>
+void run(const std::string& label) {
+  bench::report((label + " reserve 256M, append 1M").c_str(), bench::measure([] {
+    dr::gap_buffer<T> gb;
+    gb.reserve(buffer_size);
+    std::string chunk(chunk_size, 'x');
+    gb.append(chunk.begin(), chunk.end());
+    bench::do_not_optimize(gb.size());
+  }));
+
+  dr::gap_buffer<T> gb;
+  std::string chunk(chunk_size, 'x');
+  for (std::size_t i = 0; i < 64; ++i) gb.append(chunk.begin(), chunk.end());
+
+  bench::report((label + " erase 48M of 64M").c_str(), bench::measure([&] {
+    gb.erase(gb.begin() + 8 * chunk_size, gb.begin() + 56 * chunk_size);
+  }));
+
+  bench::report((label + " 16 gap moves across 16M").c_str(), bench::measure([&] {
+    for (int i = 0; i < 16; ++i)
+      gb.insert(i % 2 ? gb.end() : gb.begin(), T('y'));
+  }));
+}
+
+}
+
+int main() {
+  run<char>("char (memmove):");
+  run<boxed_char>("boxed_char (one by one):");
+}
@@ -0,0 +1,292 @@
+//
+// Editing traces replayed against dr::gap_buffer, std::vector,
+// std::string and std::deque, followed by microbenchmarks of single
+// operations.
+//
+// For each trace and container the replay reports operations per second,
+// the bytes the container's insert and erase shift around (the gap moved
+// for gap_buffer, the tail for vector and string, the shorter end for
+// deque) and the peak bytes allocated.
+//
+// Without arguments four synthetic traces are replayed on a 4 MiB
+// document: typing, random jumps, bulk paste and replace-all. Recorded
+// traces are given as files, one operation per line:
+//
+//     i <offset> <count>    insert `count` elements at `offset`
+//     d <offset> <count>    erase `count` elements at `offset`
+//
+// and are replayed on a document of the size given by an optional first
+// line `s <size>`.
+//
+// Built with -DDR_GAP_BUFFER_STATS, the gap_buffer's own storage stats
+// are printed as well.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "bench.h"
+#include "gap_buffer.h"
+
+namespace {
+
+struct op {
+  char kind;  ///< 'i' or 'd'
+  std::size_t offset;
+  std::size_t count;
+};
+
+struct trace {
+  std::string name;
+  std::size_t document_size;
+  std::vector<op> ops;
+};
+
+constexpr std::size_t document_size = std::size_t(4) << 20;
+
+/// \brief keystrokes near a cursor which now and then moves a little,
+/// with some backspacing
+trace typing() {
+  trace t{"typing", document_size, {}};
+  std::mt19937 rng(1);
+  std::size_t size = document_size;
+  std::size_t cursor = size / 3;
+  for (int i = 0; i < 20'000; ++i) {
+    if (rng() % 50 == 0) cursor = std::min(size, cursor + rng() % 200 - std::min<std::size_t>(cursor, 100));
+    if (rng() % 10 == 0 && cursor > 0) {
+      t.ops.push_back({'d', --cursor, 1});
+      --size;
+    }
+    else {
+      t.ops.push_back({'i', cursor++, 1});
+      ++size;
+    }
+  }
+  return t;
+}
+
+/// \brief short edits all over the document
+trace random_jumps() {
+  trace t{"random jumps", document_size, {}};
+  std::mt19937 rng(2);
+  std::size_t size = document_size;
+  for (int i = 0; i < 5'000; ++i) {
+    std::size_t offset = rng() % size;
+    std::size_t count = 1 + rng() % 16;
+    if (i % 2 && offset + count <= size) {
+      t.ops.push_back({'d', offset, count});
+      size -= count;
+    }
+    else {
+      t.ops.push_back({'i', offset, count});
+      size += count;
+    }
+  }
+  return t;
+}
+
+/// \brief pasting 64 KiB blocks at random places
+trace bulk_paste() {
+  trace t{"bulk paste", document_size, {}};
+  std::mt19937 rng(3);
+  std::size_t size = document_size;
+  for (int i = 0; i < 500; ++i) {
+    t.ops.push_back({'i', rng() % size, std::size_t(64) << 10});
+    size += std::size_t(64) << 10;
+  }
+  return t;
+}
+
+/// \brief a three-element match every 4 KiB replaced by five, front
+/// to back
+trace replace_all() {
+  trace t{"replace-all", document_size, {}};
+  std::size_t grown = 0;
+  for (std::size_t offset = 40; offset + 3 <= document_size; offset += 4096) {
+    t.ops.push_back({'d', offset + grown, 3});
+    t.ops.push_back({'i', offset + grown, 5});
+    grown += 2;
+  }
+  return t;
+}
+
+/// \brief read a recorded trace, checking each operation against the
+/// size of the document at that point
+trace load(const char* path) {
+  trace t{path, document_size, {}};
+  std::ifstream in(path);
+  if (!in) {
+    std::fprintf(stderr, "cannot open %s\n", path);
+    std::exit(1);
+  }
+
+  auto reject = [&](std::size_t line_number, const char* reason) {
+    std::fprintf(stderr, "%s:%zu: %s\n", path, line_number, reason);
+    std::exit(1);
+  };
+
+  std::string line;
+  std::size_t size = t.document_size;
+  for (std::size_t line_number = 1; std::getline(in, line); ++line_number) {
+    std::istringstream fields(line);
+    std::string kind, rest;
+    std::size_t a = 0, b = 0;
+    if (!(fields >> kind)) continue;  // blank line
+
+    if (kind == "s" && line_number == 1) {
+      if (!(fields >> t.document_size) || fields >> rest) reject(line_number, "expected `s <size>`");
+      size = t.document_size;
+      continue;
+    }
+
+    if (kind != "i" && kind != "d") reject(line_number, "operation must be `i` or `d`");
+    if (!(fields >> a >> b) || fields >> rest) reject(line_number, "expected `<kind> <offset> <count>`");
+    if (a > size) reject(line_number, "offset past the end of the document");
+    if (kind == "d" && b > size - a) reject(line_number, "erase past the end of the document");
+
+    t.ops.push_back({kind[0], a, b});
+    size = kind == "i" ? size + b : size - b;
+  }
+  return t;
+}
+
+template<typename T>
+using allocator = bench::counting_allocator<T>;
+
+using gap_buffer = dr::gap_buffer<char, allocator<char>>;
+using vector = std::vector<char, allocator<char>>;
+using string = std::basic_string<char, std::char_traits<char>, allocator<char>>;
+using deque = std::deque<char, allocator<char>>;
+
+template<typename C>
+constexpr bool is_gap_buffer = std::is_same_v<C, gap_buffer>;
+
+/// \brief bytes the container shifts to insert or erase at `offset`
+template<typename C>
+std::size_t shifted(const C& c, const op& o) {
+  std::size_t tail = c.size() - o.offset - (o.kind == 'd' ? o.count : 0);
+  if constexpr (is_gap_buffer<C>) {
+    std::size_t gap = c.segments().first.size();
+    return gap > o.offset ? gap - o.offset : o.offset - gap;
+  }
+  else if constexpr (std::is_same_v<C, deque>)
+    return std::min(o.offset, tail);
+  else
+    return tail;
+}
+
+template<typename C>
+C make(std::size_t size) {
+  C c;
+  std::string text(size, '.');
+  c.insert(c.end(), text.begin(), text.end());
+  return c;
+}
+
+template<typename C>
+void replay(const char* name, const trace& t) {
+  static const std::string pasted(std::size_t(1) << 20, 'x');
+
+  bench::allocation_stats::get() = {};
+  C c = make<C>(t.document_size);
+  std::size_t moved = 0;
+  auto r = bench::measure([&] {
+    for (const op& o : t.ops) {
+      moved += shifted(c, o);
+      auto pos = c.begin() + std::ptrdiff_t(o.offset);
+      if (o.kind == 'i') {
+        for (std::size_t left = o.count; left > 0;) {
+          std::size_t n = std::min(left, pasted.size());
+          pos = c.insert(pos, pasted.begin(), pasted.begin() + std::ptrdiff_t(n)) + std::ptrdiff_t(n);
+          left -= n;
+        }
+      }
+      else
+        c.erase(pos, pos + std::ptrdiff_t(o.count));
+    }
+  });
+  bench::do_not_optimize(c.size());
+
+  std::printf("  %-12s %12.0f ops/s %12.1f MiB moved %10zu KiB peak\n", name,
+              double(t.ops.size()) / r.seconds, double(moved) / (1 << 20),
+              bench::allocation_stats::get().peak_bytes >> 10);
+
+#ifdef DR_GAP_BUFFER_STATS
+  if constexpr (is_gap_buffer<C>) {
+    const dr::gap_buffer_stats& stats = c.stats();
+    std::printf("  %-12s %12llu gap relocations, %.0f average distance, %llu reallocations copying %llu bytes\n", "",
+                (unsigned long long) stats.gap_relocations, stats.average_gap_distance(),
+                (unsigned long long) stats.reallocations, (unsigned long long) stats.bytes_copied);
+  }
+#endif
+}
+
+void replay_all(const trace& t) {
+  std::printf("%s: %zu operations on %zu bytes\n", t.name.c_str(), t.ops.size(), t.document_size);
+  replay<gap_buffer>("gap_buffer", t);
+  replay<vector>("vector", t);
+  replay<string>("string", t);
+  replay<deque>("deque", t);
+}
+
+constexpr std::size_t micro_size = std::size_t(16) << 20;
+
+template<typename C>
+void micro(const char* name) {
+  std::printf("%s\n", name);
+  C c = make<C>(micro_size);
+  std::mt19937 rng(4);
+
+  char line[64];
+  std::snprintf(line, sizeof(line), "  %s operator[], 10M random reads", name);
+  bench::report(line, bench::measure([&] {
+    unsigned sum = 0;
+    for (int i = 0; i < 10'000'000; ++i) sum += static_cast<unsigned char>(c[rng() % micro_size]);
+    bench::do_not_optimize(sum);
+  }));
+
+  std::snprintf(line, sizeof(line), "  %s iteration over 16M", name);
+  bench::report(line, bench::measure([&] {
+    unsigned sum = 0;
+    for (char ch : c) sum += static_cast<unsigned char>(ch);
+    bench::do_not_optimize(sum);
+  }));
+
+  std::snprintf(line, sizeof(line), "  %s 2000 single inserts at random", name);
+  bench::report(line, bench::measure([&] {
+    for (int i = 0; i < 2000; ++i) c.insert(c.begin() + std::ptrdiff_t(rng() % c.size()), 'x');
+  }));
+
+  std::snprintf(line, sizeof(line), "  %s 2000 single erases at random", name);
+  bench::report(line, bench::measure([&] {
+    for (int i = 0; i < 2000; ++i) c.erase(c.begin() + std::ptrdiff_t(rng() % c.size()));
+  }));
+
+  if constexpr (!std::is_same_v<C, deque>) {
+    std::snprintf(line, sizeof(line), "  %s reserve twice the size", name);
+    bench::report(line, bench::measure([&] { c.reserve(2 * micro_size); }));
+  }
+}
+
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1) {
+    for (int i = 1; i < argc; ++i) replay_all(load(argv[i]));
+    return 0;
+  }
+
+  for (const trace& t : {typing(), random_jumps(), bulk_paste(), replace_all()}) replay_all(t);
+
+  micro<gap_buffer>("gap_buffer");
+  micro<vector>("vector");
+  micro<string>("string");
+  micro<deque>("deque");
+}
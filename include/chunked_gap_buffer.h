@@ -0,0 +1,726 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <gsl/gsl>
+#include "gap_buffer.h"
+
+namespace dr {
+
+/// \brief a sequence kept in bounded gap_buffer leaves under a B+ tree
+///
+/// Every node knows the number of elements below it, so locating a
+/// position costs O(log n), and an edit only ever moves the gap of one leaf
+/// of at most `LeafCapacity` elements. Leaves that grow too large are split,
+/// leaves that shrink below a quarter of `LeafCapacity` are merged with a
+/// neighbour; internal nodes hold between Fanout / 2 and Fanout children.
+///
+/// The interface follows gap_buffer. Iterators are (container, offset)
+/// pairs that cache the leaf they last looked at; as with gap_buffer they
+/// are invalidated by insertion and erasure.
+///
+/// Nodes are shared between copies and copied only when one of the copies
+/// changes them, so copying costs O(1) and an edit after a copy costs a
+/// copy of the nodes on one root-to-leaf path. A copy made on the writing
+/// thread is an immutable snapshot which other threads may read without
+/// locking while the original keeps changing. Writing through the
+/// non-const element accessors and iterators unshares the leaf written to;
+/// read through the const ones to leave shared leaves alone.
+template<typename T,
+         typename Allocator = std::allocator<T>,
+         std::size_t LeafCapacity = 4096,
+         std::size_t Fanout = 32>
+struct chunked_gap_buffer {
+  static_assert(LeafCapacity >= 4 && Fanout >= 4, "leaves and nodes must hold at least four entries");
+
+  using value_type      = T;
+  using allocator_type  = Allocator;
+  using size_type       = std::size_t;
+  using difference_type = ptrdiff_t;
+  using reference       = value_type&;
+  using const_reference = const value_type&;
+  using pointer         = value_type*;
+  using const_pointer   = const value_type*;
+
+  using leaf_type       = gap_buffer<T, Allocator>;
+  using const_span_type = gsl::span<const value_type>;
+
+private:
+  struct node;
+
+  using node_ptr        = std::shared_ptr<node>;
+  using node_allocator  = typename std::allocator_traits<Allocator>::template rebind_alloc<node>;
+  using child_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<node_ptr>;
+
+  /// Leaves and child lists use the allocator of the buffer that made the
+  /// node, also when the node is copied.
+  struct node {
+    explicit node(const Allocator& alloc)
+        : elements(0, alloc), children(child_allocator(alloc)) { }
+
+    node(const node& other, const Allocator& alloc)
+        : count(other.count), leaf(other.leaf), elements(other.elements, alloc),
+          children(other.children, child_allocator(alloc)) { }
+
+    size_type count = 0;
+    bool leaf = true;
+    leaf_type elements;
+    std::vector<node_ptr, child_allocator> children;
+  };
+
+  static constexpr size_type min_leaf_size = LeafCapacity / 4;
+  static constexpr size_type min_children = Fanout / 2;
+
+public:
+  template<bool Const>
+  struct basic_iterator {
+    using self_type         = basic_iterator;
+    using container_pointer = std::conditional_t<Const, const chunked_gap_buffer*, chunked_gap_buffer*>;
+
+    using value_type        = chunked_gap_buffer::value_type;
+    using difference_type   = chunked_gap_buffer::difference_type;
+    using reference         = std::conditional_t<Const, const_reference, chunked_gap_buffer::reference>;
+    using pointer           = std::conditional_t<Const, const_pointer, chunked_gap_buffer::pointer>;
+    using iterator_category = std::random_access_iterator_tag;
+
+    explicit basic_iterator(container_pointer container = nullptr, difference_type offset = 0)
+        : container(container), offset(offset) { }
+
+    template<bool C = Const, typename = std::enable_if_t<C>>
+    basic_iterator(const basic_iterator<false>& other)
+        : container(other.container), offset(other.offset), leaf(other.leaf), leaf_first(other.leaf_first),
+          leaf_copies(other.leaf_copies) { }
+
+    reference operator [](difference_type i) const {
+      return *(*this + i);
+    }
+
+    reference operator *() const {
+      return element();
+    }
+
+    pointer operator ->() const {
+      return &element();
+    }
+
+    self_type& operator ++() {
+      offset++;
+      return *this;
+    }
+
+    self_type operator ++(int) {
+      self_type retval = *this;
+      this->operator ++();
+      return retval;
+    }
+
+    self_type& operator --() {
+      offset--;
+      return *this;
+    }
+
+    self_type operator --(int) {
+      self_type retval = *this;
+      this->operator --();
+      return retval;
+    }
+
+    bool operator ==(const self_type& other) const {
+      return container == other.container && offset == other.offset;
+    }
+
+    bool operator !=(const self_type& other) const {
+      return !(*this == other);
+    }
+
+    bool operator <(const self_type& other) const {
+      Expects(container == other.container);
+      return offset < other.offset;
+    }
+
+    bool operator >(const self_type& other) const {
+      return other < *this;
+    }
+
+    bool operator <=(const self_type& other) const {
+      return !(other < *this);
+    }
+
+    bool operator >=(const self_type& other) const {
+      return !(*this < other);
+    }
+
+    self_type& operator +=(difference_type n) {
+      offset += n;
+      return *this;
+    }
+
+    friend
+    self_type operator +(self_type it, difference_type n) {
+      return it += n;
+    }
+
+    friend
+    self_type operator +(difference_type n, self_type it) {
+      return it += n;
+    }
+
+    self_type& operator -=(difference_type n) {
+      offset -= n;
+      return *this;
+    }
+
+    self_type operator -(difference_type n) const {
+      self_type retval = *this;
+      return retval -= n;
+    }
+
+    difference_type operator -(const self_type& other) const {
+      Expects(container == other.container);
+      return offset - other.offset;
+    }
+
+    friend struct chunked_gap_buffer;
+    template<bool> friend struct basic_iterator;
+
+  private:
+    /// the cached leaf is looked up again only once `offset` leaves it or,
+    /// for writing, once the container was copied and may share it
+    reference element() const {
+      if (!leaf || offset < leaf_first || offset >= leaf_first + difference_type(leaf->count)
+          || (!Const && leaf_copies != container->copies.load(std::memory_order_relaxed))) {
+        if constexpr (Const) {
+          auto[l, first] = container->locate(offset);
+          leaf = l;
+          leaf_first = first;
+        }
+        else {
+          auto[l, first] = container->locate_for_write(offset);
+          leaf = l;
+          leaf_first = first;
+          leaf_copies = container->copies.load(std::memory_order_relaxed);
+        }
+      }
+      return const_cast<node*>(leaf)->elements[offset - leaf_first];
+    }
+
+    container_pointer container;
+    difference_type offset;
+    mutable const node* leaf = nullptr;
+    mutable difference_type leaf_first = 0;
+    mutable size_type leaf_copies = 0;
+  };
+
+  using iterator               = basic_iterator<false>;
+  using const_iterator         = basic_iterator<true>;
+  using reverse_iterator       = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  chunked_gap_buffer() : chunked_gap_buffer(Allocator()) { }
+
+  explicit chunked_gap_buffer(const Allocator& alloc)
+      : alloc(alloc), root(new_node()) { }
+
+  chunked_gap_buffer(size_type count, const T& value, const Allocator& alloc = Allocator())
+      : chunked_gap_buffer(alloc) {
+    insert(end(), count, value);
+  }
+
+  template<typename InputIt>
+  chunked_gap_buffer(InputIt first, InputIt last, const Allocator& alloc = Allocator())
+      : chunked_gap_buffer(alloc) {
+    insert(end(), first, last);
+  }
+
+  /// Shares all nodes with `rhs`, and so its allocator as well. Copy on
+  /// the thread that writes to `rhs`.
+  chunked_gap_buffer(const chunked_gap_buffer& rhs)
+      : alloc(rhs.alloc), root(rhs.root) { rhs.copies.fetch_add(1, std::memory_order_relaxed); }
+
+  /// Shares all nodes with `rhs`; nodes made from now on come from `alloc`.
+  chunked_gap_buffer(const chunked_gap_buffer& rhs, const Allocator& alloc)
+      : alloc(alloc), root(rhs.root) { rhs.copies.fetch_add(1, std::memory_order_relaxed); }
+
+  /// Leaves `rhs` empty, which takes a new root node; unlike the move
+  /// assignment it may throw.
+  chunked_gap_buffer(chunked_gap_buffer&& rhs)
+      : alloc(rhs.alloc), root(new_node()) { swap(rhs); }
+
+  chunked_gap_buffer(std::initializer_list<T> ilist, const Allocator& alloc = Allocator())
+      : chunked_gap_buffer(ilist.begin(), ilist.end(), alloc) { }
+
+  chunked_gap_buffer& operator =(const chunked_gap_buffer& rhs) {
+    chunked_gap_buffer temp(rhs);
+    swap(temp);
+    return *this;
+  }
+
+  chunked_gap_buffer& operator =(chunked_gap_buffer&& rhs) noexcept {
+    swap(rhs);
+    return *this;
+  }
+
+  /// Nodes free themselves through the allocator that made them, so trees
+  /// can be exchanged whatever the allocators. These follow the trees if
+  /// they propagate on swap; otherwise each buffer keeps making new nodes
+  /// with its own.
+  void swap(chunked_gap_buffer& rhs) noexcept {
+    using std::swap;
+    if constexpr (std::allocator_traits<Allocator>::propagate_on_container_swap::value)
+      swap(alloc, rhs.alloc);
+    swap(root, rhs.root);
+  }
+
+  void assign(size_type count, const T& value) { *this = chunked_gap_buffer(count, value, alloc); }
+
+  template<typename InputIt>
+  void assign(InputIt first, InputIt last) { *this = chunked_gap_buffer(first, last, alloc); }
+
+  void assign(std::initializer_list<T> ilist) { *this = chunked_gap_buffer(ilist, alloc); }
+
+  allocator_type get_allocator() const { return alloc; }
+
+
+  // ------ basis START HERE ------
+
+  const_reference operator [](size_type pos) const {
+    auto[leaf, first] = locate(pos);
+    return leaf->elements[pos - first];
+  }
+
+  iterator erase(const_iterator first, const_iterator last) {
+    Expects(first.container == this && last.container == this && first <= last);
+    if (first != last) {
+      erase_from(unshare(root), first.offset, last.offset);
+      shrink_root();
+    }
+    return iterator(this, first.offset);
+  }
+
+  /// \return iterator to the first inserted element
+  template<class InputIt>
+  iterator insert(const_iterator pos, InputIt first, InputIt last) {
+    Expects(this == pos.container && pos.offset <= difference_type(size()));
+
+    size_type num_to_insert = std::distance(first, last);
+    if (num_to_insert > 0)
+      grow_root(insert_into(unshare(root), pos.offset, num_to_insert, first, last));
+    return iterator(this, pos.offset);
+  }
+
+  size_type size() const noexcept { return root->count; }
+  size_type max_size() const noexcept { return std::numeric_limits<difference_type>::max() / sizeof(T); }
+
+  // ------ basis END HERE ------
+
+  reference operator [](size_type pos) {
+    auto[leaf, first] = locate_for_write(pos);
+    return leaf->elements[pos - first];
+  }
+
+  const_reference at(size_type pos) const {
+    if (pos >= size()) throw std::out_of_range("index out of range");
+    return (*this)[pos];
+  }
+
+  reference at(size_type pos) {
+    if (pos >= size()) throw std::out_of_range("index out of range");
+    return (*this)[pos];
+  }
+
+  const_reference front() const { return (*this)[0]; }
+  reference front() { return (*this)[0]; }
+
+  const_reference back() const { return (*this)[size() - 1]; }
+  reference back() { return (*this)[size() - 1]; }
+
+  [[nodiscard]] bool empty() const noexcept { return size() == 0; }
+
+  void clear() { root = new_node(); }
+
+  void resize(size_type count, const value_type& value = value_type{}) {
+    if (count < size())
+      erase(begin() + count, end());
+    else
+      insert(end(), count - size(), value);
+  }
+
+  iterator insert(const_iterator pos, const T& value) {
+    return insert(pos, &value, &value + 1);
+  }
+
+  iterator insert(const_iterator pos, T&& value) {
+    return insert(pos, std::make_move_iterator(&value), std::make_move_iterator(&value + 1));
+  }
+
+  iterator insert(const_iterator pos, size_type count, const T& value) {
+    // fill one leaf worth at a time instead of element by element
+    difference_type offset = pos.offset;
+    std::vector<T> run(std::min(count, LeafCapacity), value);
+    for (size_type done = 0; done < count; done += run.size()) {
+      size_type n = std::min(count - done, run.size());
+      insert(const_iterator(this, offset + difference_type(done)), run.begin(), run.begin() + n);
+    }
+    return iterator(this, offset);
+  }
+
+  iterator insert(const_iterator pos, std::initializer_list<T> ilist) {
+    return insert(pos, ilist.begin(), ilist.end());
+  }
+
+  void erase(const_iterator pos) { erase(pos, pos + 1); }
+
+  template<typename ... Args>
+  iterator emplace(const_iterator pos, Args&& ... args) {
+    return insert(pos, T(std::forward<Args>(args)...));
+  }
+
+  template<typename ... Args>
+  reference emplace_back(Args&& ... args) {
+    return *emplace(end(), std::forward<Args>(args)...);
+  }
+
+  void push_back(const T& value) { insert(end(), value); }
+  void push_back(T&& value) { insert(end(), std::move(value)); }
+  void pop_back() { erase(end() - 1); }
+
+  const_iterator begin() const noexcept { return const_iterator(this); }
+  const_iterator cbegin() const noexcept { return begin(); }
+
+  const_iterator end() const noexcept { return const_iterator(this, size()); }
+  const_iterator cend() const noexcept { return end(); }
+
+  iterator begin() noexcept { return iterator(this); }
+  iterator end() noexcept { return iterator(this, size()); }
+
+  const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+  const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+
+  const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+  const_reverse_iterator crend() const noexcept { return rend(); }
+
+  reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+  reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
+
+  /// \brief call `f` with every contiguous run of elements, in order
+  template<typename F>
+  void for_each_segment(F f) const {
+    for_each_leaf(*root, [&](const leaf_type& leaf) {
+      auto[front, back] = leaf.segments();
+      if (!front.empty()) f(front);
+      if (!back.empty()) f(back);
+    });
+  }
+
+  /// \brief number of levels below the root; 0 while the root is a leaf
+  size_type height() const noexcept {
+    size_type h = 0;
+    for (const node* n = root.get(); !n->leaf; n = n->children.front().get()) ++h;
+    return h;
+  }
+
+  friend
+  bool operator ==(const chunked_gap_buffer& lhs, const chunked_gap_buffer& rhs) {
+    return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+  }
+
+  friend
+  bool operator !=(const chunked_gap_buffer& lhs, const chunked_gap_buffer& rhs) {
+    return !(lhs == rhs);
+  }
+
+  friend
+  bool operator <(const chunked_gap_buffer& lhs, const chunked_gap_buffer& rhs) {
+    return std::lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+  }
+
+  friend
+  bool operator >(const chunked_gap_buffer& lhs, const chunked_gap_buffer& rhs) {
+    return rhs < lhs;
+  }
+
+  friend
+  bool operator <=(const chunked_gap_buffer& lhs, const chunked_gap_buffer& rhs) {
+    return !(rhs < lhs);
+  }
+
+  friend
+  bool operator >=(const chunked_gap_buffer& lhs, const chunked_gap_buffer& rhs) {
+    return !(lhs < rhs);
+  }
+
+  // additional
+  template<typename InputIt>
+  void append(InputIt first, InputIt last) {
+    insert(end(), first, last);
+  }
+
+  void append(const T& value) { push_back(value); }
+
+  void append(T&& value) { push_back(std::move(value)); }
+
+  template<typename InputIt>
+  void replace(const_iterator f1, const_iterator l1, InputIt f2, InputIt l2) {
+    auto cursor = erase(f1, l1);
+    insert(cursor, f2, l2);
+  }
+
+  template<typename InputIt>
+  void replace(const_iterator pos, InputIt first, InputIt last) {
+    replace(pos, pos + 1, first, last);
+  }
+
+  chunked_gap_buffer substr(const_iterator first, const_iterator last) const {
+    return chunked_gap_buffer(first, last, alloc);
+  }
+
+  /// \brief an immutable copy sharing all nodes with this buffer
+  ///
+  /// Take it on the thread that edits this buffer; it can then be handed to
+  /// and read by any other thread.
+  std::shared_ptr<const chunked_gap_buffer> snapshot() const {
+    using self_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<chunked_gap_buffer>;
+    return std::allocate_shared<chunked_gap_buffer>(self_allocator(alloc), *this);
+  }
+
+protected:
+
+  /// \return the leaf holding position `pos` and the position of its first
+  /// element; the past-the-end position maps to the end of the last leaf
+  std::pair<const node*, difference_type> locate(difference_type pos) const {
+    const node* n = root.get();
+    difference_type first = 0;
+    while (!n->leaf) {
+      auto& children = n->children;
+      size_type i = 0;
+      while (i + 1 < children.size() && pos - first >= difference_type(children[i]->count)) {
+        first += children[i]->count;
+        ++i;
+      }
+      n = children[i].get();
+    }
+    return {n, first};
+  }
+
+  /// \brief locate() for writing: the nodes on the path are unshared
+  std::pair<node*, difference_type> locate_for_write(difference_type pos) {
+    node* n = &unshare(root);
+    difference_type first = 0;
+    while (!n->leaf) {
+      auto& children = n->children;
+      size_type i = 0;
+      while (i + 1 < children.size() && pos - first >= difference_type(children[i]->count)) {
+        first += children[i]->count;
+        ++i;
+      }
+      n = &unshare(children[i]);
+    }
+    return {n, first};
+  }
+
+  node_ptr new_node() const {
+    return std::allocate_shared<node>(node_allocator(alloc), alloc);
+  }
+
+  /// \brief make `p` the only owner of its node, copying the node if it
+  /// is shared with another buffer
+  ///
+  /// Only the nodes below an unshared node can be unshared this way;
+  /// everything reachable from another buffer holds at least two owners.
+  node& unshare(node_ptr& p) {
+    if (p.use_count() != 1)
+      p = std::allocate_shared<node>(node_allocator(alloc), *p, alloc);
+    else
+      // order our writes after the reads of the buffer that dropped
+      // its share
+      std::atomic_thread_fence(std::memory_order_acquire);
+    return *p;
+  }
+
+  /// \brief insert into the subtree `n`
+  /// \return the nodes split off `n`, to be placed right behind it
+  template<typename InputIt>
+  std::vector<node_ptr> insert_into(node& n, size_type pos, size_type count, InputIt first, InputIt last) {
+    n.count += count;
+    if (n.leaf) {
+      n.elements.insert(n.elements.begin() + pos, first, last);
+      return n.count > LeafCapacity ? split(n) : std::vector<node_ptr>{};
+    }
+
+    // a position on the border of two children goes to the end of the left one
+    size_type i = 0;
+    while (i + 1 < n.children.size() && pos > n.children[i]->count) pos -= n.children[i++]->count;
+
+    auto siblings = insert_into(unshare(n.children[i]), pos, count, first, last);
+    n.children.insert(n.children.begin() + i + 1,
+                      std::make_move_iterator(siblings.begin()), std::make_move_iterator(siblings.end()));
+    return n.children.size() > Fanout ? split(n) : std::vector<node_ptr>{};
+  }
+
+  /// \brief remove the elements [first, last) of the subtree `n`
+  void erase_from(node& n, size_type first, size_type last) {
+    n.count -= last - first;
+    if (n.leaf) {
+      n.elements.erase(n.elements.begin() + first, n.elements.begin() + last);
+      return;
+    }
+
+    std::vector<node_ptr, child_allocator> kept(n.children.get_allocator());
+    std::vector<size_type> touched;
+    size_type child_first = 0;
+    for (auto& child : n.children) {
+      size_type child_last = child_first + child->count;
+      size_type f = std::max(first, child_first);
+      size_type l = std::min(last, child_last);
+      if (f >= l) {
+        kept.push_back(std::move(child));
+      }
+      else if (f > child_first || l < child_last) {
+        erase_from(unshare(child), f - child_first, l - child_first);
+        touched.push_back(kept.size());
+        kept.push_back(std::move(child));
+      }
+      child_first = child_last;
+    }
+    n.children = std::move(kept);
+
+    // only the children at the ends of the range can have become too small;
+    // fix the right one first so the left index stays valid
+    for (auto it = touched.rbegin(); it != touched.rend(); ++it)
+      if (*it < n.children.size()) fix_underflow(n, *it);
+  }
+
+  bool underfull(const node& n) const {
+    return n.leaf ? n.count < min_leaf_size : n.children.size() < min_children;
+  }
+
+  bool overfull(const node& n) const {
+    return n.leaf ? n.count > LeafCapacity : n.children.size() > Fanout;
+  }
+
+  /// \brief merge child `i` of `n` into a neighbour if it is too small,
+  /// splitting the result again if that made it too large
+  void fix_underflow(node& n, size_type i) {
+    if (n.children.size() < 2 || !underfull(*n.children[i])) return;
+
+    size_type left = i + 1 < n.children.size() ? i : i - 1;
+    node& l = unshare(n.children[left]);
+    const node& r = *n.children[left + 1];
+    if (l.leaf) {
+      auto[front, back] = r.elements.segments();
+      l.elements.append(front.begin(), front.end());
+      l.elements.append(back.begin(), back.end());
+    }
+    else {
+      // `r` may be shared, so its children are copied rather than moved
+      size_type seam = l.children.size() - 1;
+      l.children.insert(l.children.end(), r.children.begin(), r.children.end());
+      // the children meeting at the seam may be small as well
+      fix_underflow(l, seam + 1);
+      fix_underflow(l, seam);
+    }
+    l.count += r.count;
+    n.children.erase(n.children.begin() + left + 1);
+
+    if (overfull(l)) {
+      auto siblings = split(l);
+      n.children.insert(n.children.begin() + left + 1,
+                        std::make_move_iterator(siblings.begin()), std::make_move_iterator(siblings.end()));
+    }
+  }
+
+  /// \brief split `n` into pieces of equal size that are within bounds
+  /// \return all pieces but the first, which stays in `n`
+  std::vector<node_ptr> split(node& n) {
+    size_type total = n.leaf ? n.count : n.children.size();
+    size_type limit = n.leaf ? LeafCapacity : Fanout;
+    size_type pieces = std::max<size_type>(2, (total + limit - 1) / limit);
+
+    std::vector<node_ptr> result;
+    for (size_type k = 1; k < pieces; ++k) {
+      size_type f = total * k / pieces;
+      size_type l = total * (k + 1) / pieces;
+      auto piece = new_node();
+      piece->leaf = n.leaf;
+      if (n.leaf) {
+        auto[front, back] = n.elements.segments(n.elements.begin() + f, n.elements.begin() + l);
+        piece->elements.reserve(l - f);
+        piece->elements.append(front.begin(), front.end());
+        piece->elements.append(back.begin(), back.end());
+        piece->count = l - f;
+      }
+      else {
+        for (size_type c = f; c < l; ++c) {
+          piece->count += n.children[c]->count;
+          piece->children.push_back(std::move(n.children[c]));
+        }
+      }
+      result.push_back(std::move(piece));
+    }
+
+    size_type keep = total / pieces;
+    if (n.leaf) {
+      n.elements.erase(n.elements.begin() + keep, n.elements.end());
+      n.count = keep;
+    }
+    else {
+      n.children.resize(keep);
+      n.count = 0;
+      for (auto& child : n.children) n.count += child->count;
+    }
+    return result;
+  }
+
+  /// \brief put a new root above the old one while it has split siblings
+  void grow_root(std::vector<node_ptr> siblings) {
+    while (!siblings.empty()) {
+      auto new_root = new_node();
+      new_root->leaf = false;
+      new_root->count = root->count;
+      new_root->children.push_back(std::move(root));
+      for (auto& sibling : siblings) {
+        new_root->count += sibling->count;
+        new_root->children.push_back(std::move(sibling));
+      }
+      root = std::move(new_root);
+      siblings = overfull(*root) ? split(*root) : std::vector<node_ptr>{};
+    }
+  }
+
+  /// \brief drop root levels with a single child
+  void shrink_root() {
+    while (!root->leaf && root->children.size() <= 1) {
+      if (root->children.empty()) root = new_node();
+      else root = node_ptr(root->children.front());
+    }
+  }
+
+  template<typename F>
+  static void for_each_leaf(const node& n, F&& f) {
+    if (n.leaf) f(n.elements);
+    else for (auto& child : n.children) for_each_leaf(*child, f);
+  }
+
+private:
+  Allocator alloc;
+  node_ptr root;
+
+  /// bumped whenever another buffer may have come to share our nodes
+  mutable std::atomic<size_type> copies{0};
+};
+
+template<typename T, typename Allocator, std::size_t LeafCapacity, std::size_t Fanout>
+void swap(chunked_gap_buffer<T, Allocator, LeafCapacity, Fanout>& lhs,
+          chunked_gap_buffer<T, Allocator, LeafCapacity, Fanout>& rhs) noexcept {
+  lhs.swap(rhs);
+}
+
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <gsl/gsl>
+#include "chunked_gap_buffer.h"
+
+namespace dr {
+
+/// \brief a buffer edited by one thread and read by many without locks
+///
+/// The writer edits a private chunked_gap_buffer and publishes its state
+/// as a new version. Versions share all unchanged nodes, so publishing
+/// costs O(1) plus the path copies of the edits made since. Readers pin
+/// the version current when they start reading and traverse it without
+/// taking any lock; the writer never waits for them.
+///
+/// Replaced versions are freed by epoch-based reclamation: each one is
+/// stamped with the epoch in which it was replaced and freed once every
+/// reader that is still pinned started in a later epoch.
+template<typename T,
+         typename Allocator = std::allocator<T>,
+         std::size_t LeafCapacity = 4096,
+         std::size_t Fanout = 32>
+struct concurrent_buffer {
+  using buffer_type = chunked_gap_buffer<T, Allocator, LeafCapacity, Fanout>;
+  using size_type   = std::size_t;
+
+private:
+  /// \brief the epoch a reader is pinned in, 0 while it is not reading
+  struct alignas(64) slot {
+    std::atomic<std::uint64_t> epoch{0};
+    std::atomic<bool> taken{false};
+  };
+
+public:
+  /// \brief a pinned version, readable until the guard is destroyed
+  struct read_guard {
+    read_guard(const read_guard&) = delete;
+    read_guard& operator =(const read_guard&) = delete;
+
+    ~read_guard() { pin->store(0, std::memory_order_release); }
+
+    const buffer_type& operator *() const noexcept { return *version; }
+    const buffer_type* operator ->() const noexcept { return version; }
+
+  private:
+    friend concurrent_buffer;
+
+    read_guard(std::atomic<std::uint64_t>* pin, const buffer_type* version)
+        : pin(pin), version(version) { }
+
+    std::atomic<std::uint64_t>* pin;
+    const buffer_type* version;
+  };
+
+  /// \brief a registered reader; use it from one thread at a time
+  struct reader {
+    reader(reader&& rhs) noexcept
+        : owner(std::exchange(rhs.owner, nullptr)), own_slot(rhs.own_slot) { }
+
+    reader(const reader&) = delete;
+    reader& operator =(const reader&) = delete;
+    reader& operator =(reader&&) = delete;
+
+    ~reader() {
+      if (owner) own_slot->taken.store(false, std::memory_order_release);
+    }
+
+    /// \brief pin the current version; one guard per reader at a time
+    read_guard read() const {
+      Expects(own_slot->epoch.load(std::memory_order_relaxed) == 0);
+
+      // announce the epoch before looking at the version; the writer
+      // reads the slots after replacing the version and bumping the
+      // epoch, so it either sees this pin or we see its new version
+      own_slot->epoch.store(owner->global_epoch.load());
+      return read_guard(&own_slot->epoch, owner->current.load());
+    }
+
+  private:
+    friend concurrent_buffer;
+
+    reader(const concurrent_buffer* owner, slot* own_slot)
+        : owner(owner), own_slot(own_slot) { }
+
+    const concurrent_buffer* owner;
+    slot* own_slot;
+  };
+
+  /// \param max_readers number of readers that can be registered at once
+  explicit concurrent_buffer(size_type max_readers = 64)
+      : slots(new slot[max_readers]), slot_count(max_readers) {
+    current.store(new buffer_type(working));
+  }
+
+  template<typename InputIt>
+  concurrent_buffer(InputIt first, InputIt last, size_type max_readers = 64)
+      : concurrent_buffer(max_readers) {
+    working.append(first, last);
+    publish();
+  }
+
+  concurrent_buffer(const concurrent_buffer&) = delete;
+  concurrent_buffer& operator =(const concurrent_buffer&) = delete;
+
+  /// All readers must be gone.
+  ~concurrent_buffer() {
+    for (auto& r : retired) delete r.first;
+    delete current.load();
+  }
+
+  /// \brief register a reader
+  /// \throw std::length_error if max_readers readers are registered
+  reader make_reader() {
+    for (size_type i = 0; i < slot_count; ++i) {
+      bool expected = false;
+      if (slots[i].taken.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        return reader(this, &slots[i]);
+    }
+    throw std::length_error("too many readers");
+  }
+
+  /// \brief the writer's own copy; edits become visible with publish()
+  ///
+  /// Only the writing thread may use it.
+  buffer_type& edit() noexcept { return working; }
+
+  /// \brief make the current state of edit() the version new readers see
+  void publish() {
+    auto next = new buffer_type(working);
+    const buffer_type* old = current.exchange(next);
+    retired.emplace_back(old, global_epoch.fetch_add(1));
+    reclaim();
+  }
+
+  /// \brief edit through `f` and publish the result
+  template<typename F>
+  void update(F f) {
+    f(working);
+    publish();
+  }
+
+  /// \brief number of replaced versions not yet freed
+  size_type pending() const noexcept { return retired.size(); }
+
+protected:
+  /// \brief free the versions no pinned reader can be looking at
+  void reclaim() {
+    std::uint64_t oldest = global_epoch.load();
+    for (size_type i = 0; i < slot_count; ++i) {
+      std::uint64_t e = slots[i].epoch.load();
+      if (e != 0 && e < oldest) oldest = e;
+    }
+
+    // retired versions are in epoch order
+    size_type freed = 0;
+    while (freed < retired.size() && retired[freed].second < oldest) delete retired[freed++].first;
+    retired.erase(retired.begin(), retired.begin() + freed);
+  }
+
+private:
+  buffer_type working;
+  std::atomic<const buffer_type*> current{nullptr};
+  std::atomic<std::uint64_t> global_epoch{1};
+
+  std::unique_ptr<slot[]> slots;
+  size_type slot_count;
+
+  /// replaced versions with the epoch they were replaced in, oldest first
+  std::vector<std::pair<const buffer_type*, std::uint64_t>> retired;
+};
+
+}
@@ -0,0 +1,332 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <vector>
+#include <gsl/gsl>
+#include "fenwick_tree.h"
+#include "gap_buffer.h"
+#include "segmented_algorithm.h"
+
+namespace dr {
+
+namespace detail {
+
+/// \brief polynomial hash modulo the Mersenne prime 2^61 - 1
+///
+/// A sequence x1 ... xn hashes to x1 B^(n-1) + ... + xn with a fixed base
+/// B. The hash of a concatenation follows from those of its parts,
+/// H(ab) = H(a) B^|b| + H(b), so a sequence can be hashed piecewise and
+/// pieces can be recombined without seeing their elements again. It is a
+/// checksum against accidental equality, not against crafted collisions.
+template<typename V>
+struct polynomial_hash {
+  static constexpr std::uint64_t modulus = (std::uint64_t(1) << 61) - 1;
+  static constexpr std::uint64_t base = 0x1c3f5e2b7a9d4e1;
+
+  /// \brief the hash of a sequence with B^n for its length n
+  struct node {
+    std::uint64_t hash = 0;
+    std::uint64_t power = 1;
+  };
+
+  static constexpr std::uint64_t reduce(std::uint64_t x) noexcept {
+    x = (x & modulus) + (x >> 61);
+    return x >= modulus ? x - modulus : x;
+  }
+
+  static constexpr std::uint64_t mul(std::uint64_t a, std::uint64_t b) noexcept {
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 p = (unsigned __int128) a * b;
+    return reduce((std::uint64_t(p) & modulus) + std::uint64_t(p >> 61));
+#else
+    // a and b are below 2^61; 2^64 is 8 and 2^61 is 1 modulo 2^61 - 1
+    std::uint64_t al = a & 0xffffffff, ah = a >> 32;
+    std::uint64_t bl = b & 0xffffffff, bh = b >> 32;
+    std::uint64_t lo = al * bl, mid = al * bh + ah * bl, hi = ah * bh;
+    return reduce((lo & modulus) + (lo >> 61) + (hi << 3) + (mid >> 29) + ((mid & 0x1fffffff) << 32));
+#endif
+  }
+
+  static constexpr std::uint64_t power(std::uint64_t n) noexcept {
+    std::uint64_t result = 1, b = base;
+    for (; n; n >>= 1) {
+      if (n & 1) result = mul(result, b);
+      b = mul(b, b);
+    }
+    return result;
+  }
+
+  /// \brief the value an element adds to the hash, never 0 so that
+  /// leading zeros count
+  static std::uint64_t digit(const V& v) {
+    if constexpr (simd::is_byte_v<V>)
+      return std::uint64_t(static_cast<unsigned char>(v)) + 1;
+    else
+      return std::uint64_t(std::hash<V>()(v)) % (modulus - 1) + 1;
+  }
+
+  static constexpr std::size_t stride = 256;
+
+  /// \brief B^(stride - 1 - j) split into its low 32 and high 29 bits
+  struct power_table {
+    std::uint32_t low[stride] = {};
+    std::uint32_t high[stride] = {};
+    std::uint64_t stride_power = 0;
+  };
+
+  static constexpr power_table make_power_table() noexcept {
+    power_table table;
+    std::uint64_t b = 1;
+    for (std::size_t j = stride; j-- > 0; b = mul(b, base)) {
+      table.low[j] = std::uint32_t(b);
+      table.high[j] = std::uint32_t(b >> 32);
+    }
+    table.stride_power = b;
+    return table;
+  }
+
+  /// \brief the hash of `stride` bytes as a dot product with the powers
+  ///
+  /// A digit times a 32-bit half of a power stays below 2^41, so the sums
+  /// of both halves need no reduction within a stride and the loop
+  /// vectorizes with 32 by 32 bit multiplications.
+  static std::uint64_t stride_hash(const V* p, const power_table& table) noexcept {
+    std::uint64_t low = 0, high = 0;
+    for (std::size_t j = 0; j < stride; ++j) {
+      std::uint64_t d = std::uint64_t(static_cast<unsigned char>(p[j])) + 1;
+      low += d * table.low[j];
+      high += d * table.high[j];
+    }
+    return reduce(reduce(low) + mul(reduce(high), std::uint64_t(1) << 32));
+  }
+
+  static constexpr node combine(const node& a, const node& b) noexcept {
+    return {reduce(mul(a.hash, b.power) + b.hash), mul(a.power, b.power)};
+  }
+
+  /// Four elements per step keep only one multiplication on the chain of
+  /// dependent ones; five terms below 2^61 sum to less than 2^64. Bytes go
+  /// a stride at a time through stride_hash() first.
+  static node hash(const V* p, std::size_t n) {
+    constexpr std::uint64_t b2 = power(2), b3 = power(3), b4 = power(4);
+    std::uint64_t h = 0;
+    std::size_t i = 0;
+    if constexpr (simd::is_byte_v<V>) {
+      static constexpr power_table table = make_power_table();
+      for (; i + stride <= n; i += stride) h = reduce(mul(h, table.stride_power) + stride_hash(p + i, table));
+    }
+    for (; i + 4 <= n; i += 4)
+      h = reduce(mul(h, b4) + mul(digit(p[i]), b3) + mul(digit(p[i + 1]), b2)
+                 + mul(digit(p[i + 2]), base) + digit(p[i + 3]));
+    for (; i < n; ++i) h = reduce(mul(h, base) + digit(p[i]));
+    return {h, power(n)};
+  }
+
+  template<typename SegIt>
+  static node hash(SegIt first, SegIt last) {
+    auto[front, back] = segments(first, last);
+    return combine(hash(front.data(), front.size()), hash(back.data(), back.size()));
+  }
+
+  /// \brief the published value, which also depends on the length
+  static constexpr std::uint64_t finish(const node& n, std::uint64_t length) noexcept {
+    std::uint64_t x = n.hash ^ (length * 0x9e3779b97f4a7c15);
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+    return x ^ (x >> 31);
+  }
+};
+
+}
+
+/// \brief the hash of [first, last) that a content_hash of the same
+/// elements reports, computed in one pass without copying them out
+template<typename SegIt,
+         std::enable_if_t<is_segmented_iterator_v<SegIt>, int> = 0>
+std::uint64_t content_hash_of(SegIt first, SegIt last) {
+  using hasher = detail::polynomial_hash<typename std::iterator_traits<SegIt>::value_type>;
+  return hasher::finish(hasher::hash(first, last), std::uint64_t(last - first));
+}
+
+/// \brief hash of the contents of a gap_buffer, kept up to date as it is
+/// edited
+///
+/// The buffer is covered by consecutive blocks of around `block_size`
+/// elements, each with its own polynomial hash. A tree over the blocks
+/// combines them into the hash of the whole, so value() is O(1) and an
+/// edit rehashes the block it touches and the O(log n) tree nodes above
+/// it. The hash depends on the contents alone: the same elements hash
+/// the same whatever the gap, the edit history or the block boundaries.
+///
+/// Elements changed through references or iterators are not reported to
+/// listeners; call reset() after writing to the buffer that way.
+template<typename GapBuffer>
+struct content_hash : GapBuffer::edit_listener {
+  using buffer_type = GapBuffer;
+  using value_type  = typename GapBuffer::value_type;
+  using size_type   = typename GapBuffer::size_type;
+
+  explicit content_hash(GapBuffer& buffer, size_type block_size = 1024)
+      : buffer(buffer), block_size(block_size) {
+    Expects(block_size > 0);
+    reset(buffer);
+    buffer.attach(*this);
+  }
+
+  content_hash(const content_hash&) = delete;
+  content_hash& operator =(const content_hash&) = delete;
+
+  ~content_hash() override { buffer.detach(*this); }
+
+  size_type size() const noexcept { return total_length; }
+
+  /// \brief the hash of the contents, equal to content_hash_of() over them
+  std::uint64_t value() const noexcept { return hasher::finish(tree[1], total_length); }
+
+  /// \brief whether both buffers hold the same elements
+  ///
+  /// Buffers of different sizes or hashes differ without a look at their
+  /// elements; only equal hashes are confirmed by comparing them.
+  bool equals(const content_hash& other) const {
+    if (total_length != other.total_length || value() != other.value()) return false;
+    return &buffer == &other.buffer || buffer == other.buffer;
+  }
+
+  void inserted(const GapBuffer& gb, size_type offset, size_type count) override {
+    size_type k = std::max<size_type>(length_tree.lower_bound(offset), 1) - 1;
+    lengths[k] += count;
+    length_tree.add(k, count);
+    total_length += count;
+    if (lengths[k] > 2 * block_size) split(gb, k);
+    else {
+      size_type block_start = length_tree.prefix(k);
+      set_block(k, hash_range(gb, block_start, block_start + lengths[k]));
+    }
+  }
+
+  /// The elements are still there, so a block losing part of them is
+  /// rehashed from the parts that remain.
+  void erasing(const GapBuffer& gb, size_type offset, size_type count) override {
+    size_type k = length_tree.lower_bound(offset + 1) - 1;
+    size_type block_start = length_tree.prefix(k);
+    size_type last = offset + count;
+
+    while (offset < last) {
+      size_type block_end = block_start + lengths[k];
+      size_type part_end = std::min(last, block_end);
+      size_type removed = part_end - offset;
+      node rest = offset == block_start && part_end == block_end
+                  ? node()
+                  : hasher::combine(hash_range(gb, block_start, offset), hash_range(gb, part_end, block_end));
+      lengths[k] -= removed;
+      length_tree.add(k, 0 - removed);
+      total_length -= removed;
+      set_block(k, rest);
+
+      offset = part_end;
+      block_start = block_end;
+      ++k;
+    }
+
+    if (lengths.size() > 2 * (total_length / block_size) + 2) compact();
+  }
+
+  void reset(const GapBuffer& gb) override {
+    lengths.clear();
+    blocks.clear();
+    total_length = gb.size();
+    for (size_type first = 0; first < total_length || lengths.empty(); first += block_size) {
+      size_type last = std::min(first + block_size, total_length);
+      lengths.push_back(last - first);
+      blocks.push_back(hash_range(gb, first, last));
+    }
+    rebuild_trees();
+  }
+
+protected:
+  using hasher = detail::polynomial_hash<value_type>;
+  using node   = typename hasher::node;
+
+  static node hash_range(const GapBuffer& gb, size_type first, size_type last) {
+    return hasher::hash(gb.cbegin() + first, gb.cbegin() + last);
+  }
+
+  /// \brief store the hash of block `k` and recombine the nodes above it
+  void set_block(size_type k, const node& n) {
+    blocks[k] = n;
+    size_type i = leaves + k;
+    tree[i] = n;
+    for (i /= 2; i > 0; i /= 2) tree[i] = hasher::combine(tree[2 * i], tree[2 * i + 1]);
+  }
+
+  /// \brief cut block `k` into pieces of at most block_size elements
+  void split(const GapBuffer& gb, size_type k) {
+    size_type first = length_tree.prefix(k);
+    size_type last = first + lengths[k];
+    size_type pieces = (lengths[k] + block_size - 1) / block_size;
+
+    std::vector<size_type> piece_lengths;
+    std::vector<node> piece_blocks;
+    for (size_type i = 0; i < pieces; ++i) {
+      size_type f = first + (last - first) * i / pieces;
+      size_type l = first + (last - first) * (i + 1) / pieces;
+      piece_lengths.push_back(l - f);
+      piece_blocks.push_back(hash_range(gb, f, l));
+    }
+
+    lengths.erase(lengths.begin() + k);
+    blocks.erase(blocks.begin() + k);
+    lengths.insert(lengths.begin() + k, piece_lengths.begin(), piece_lengths.end());
+    blocks.insert(blocks.begin() + k, piece_blocks.begin(), piece_blocks.end());
+    rebuild_trees();
+  }
+
+  /// \brief merge runs of neighbouring blocks that fit in one block, from
+  /// their hashes alone
+  void compact() {
+    size_type out = 0;
+    for (size_type i = 1; i < lengths.size(); ++i) {
+      if (lengths[out] + lengths[i] <= block_size) {
+        lengths[out] += lengths[i];
+        blocks[out] = hasher::combine(blocks[out], blocks[i]);
+      }
+      else {
+        ++out;
+        lengths[out] = lengths[i];
+        blocks[out] = blocks[i];
+      }
+    }
+    lengths.resize(out + 1);
+    blocks.resize(out + 1);
+    rebuild_trees();
+  }
+
+  /// The block hashes sit in the leaves of a complete binary tree, in
+  /// order and padded with empty ones; each inner node combines its two
+  /// children, the root the whole buffer.
+  void rebuild_trees() {
+    length_tree.assign(lengths);
+    leaves = 1;
+    while (leaves < blocks.size()) leaves *= 2;
+    tree.assign(2 * leaves, node());
+    std::copy(blocks.begin(), blocks.end(), tree.begin() + leaves);
+    for (size_type i = leaves - 1; i > 0; --i) tree[i] = hasher::combine(tree[2 * i], tree[2 * i + 1]);
+  }
+
+private:
+  GapBuffer& buffer;
+  size_type block_size;
+
+  std::vector<size_type> lengths;  ///< elements per block
+  std::vector<node> blocks;        ///< hash per block
+  detail::fenwick_tree length_tree;
+  std::vector<node> tree;          ///< tree[1] is the root, tree[leaves + k] block k
+  size_type leaves = 1;
+  size_type total_length = 0;
+};
+
+}
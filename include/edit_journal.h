@@ -0,0 +1,247 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <vector>
+#include <gsl/gsl>
+#include "gap_buffer.h"
+
+namespace dr {
+
+/// \brief undo and redo for the edits made to a gap_buffer
+///
+/// Every insertion and erasure is recorded as its offset plus the elements
+/// inserted or erased, which are kept back to back in one arena. Typing
+/// and deleting at one place extend the last record instead of adding
+/// one, up to `coalesce_limit` elements, so that a run of keystrokes is
+/// undone in one step. undo() and redo() replay a step in O(size of its
+/// edits). When the history needs more than `memory_limit` bytes, the
+/// oldest steps are forgotten.
+template<typename GapBuffer>
+struct edit_journal : GapBuffer::edit_listener {
+  using buffer_type = GapBuffer;
+  using value_type  = typename GapBuffer::value_type;
+  using size_type   = typename GapBuffer::size_type;
+
+  static constexpr size_type default_memory_limit = size_type(64) << 20;
+  static constexpr size_type default_coalesce_limit = 256;
+
+  explicit edit_journal(GapBuffer& buffer,
+                        size_type memory_limit = default_memory_limit,
+                        size_type coalesce_limit = default_coalesce_limit)
+      : buffer(buffer), memory_limit(memory_limit), coalesce_limit(coalesce_limit) {
+    buffer.attach(*this);
+  }
+
+  edit_journal(const edit_journal&) = delete;
+  edit_journal& operator =(const edit_journal&) = delete;
+
+  ~edit_journal() override { buffer.detach(*this); }
+
+  bool can_undo() const noexcept { return done > 0; }
+  bool can_redo() const noexcept { return done < records.size(); }
+
+  /// \brief revert the last step
+  /// \return false if there is nothing to undo
+  bool undo() {
+    if (!can_undo()) return false;
+    replay([this] {
+      for (;;) {
+        const record& r = records[--done];
+        if (r.erase) insert_text(r);
+        else erase_text(r);
+        if (!r.joined) break;
+      }
+    });
+    return true;
+  }
+
+  /// \brief repeat the last undone step
+  /// \return false if there is nothing to redo
+  bool redo() {
+    if (!can_redo()) return false;
+    replay([this] {
+      do {
+        const record& r = records[done++];
+        if (r.erase) erase_text(r);
+        else insert_text(r);
+      } while (done < records.size() && records[done].joined);
+    });
+    return true;
+  }
+
+  /// \brief undo the edits up to the matching end_group() in one step
+  ///
+  /// Groups nest; only the outermost one counts.
+  void begin_group() {
+    if (depth++ == 0) {
+      sealed = true;
+      group_start = true;
+    }
+  }
+
+  void end_group() {
+    Expects(depth > 0);
+    if (--depth == 0) sealed = true;
+  }
+
+  /// \brief start a new step with the next edit even if it continues the
+  /// last one, e.g. because the cursor was moved in between
+  void seal() noexcept { sealed = true; }
+
+  void clear() {
+    records.clear();
+    arena.clear();
+    dropped = 0;
+    done = 0;
+    sealed = true;
+  }
+
+  /// \brief bytes held by the history
+  size_type memory_used() const noexcept {
+    return (arena.size() - dead_prefix()) * sizeof(value_type) + records.size() * sizeof(record);
+  }
+
+  void inserted(const GapBuffer& gb, size_type offset, size_type count) override {
+    if (replaying) return;
+    drop_redo();
+
+    record* last = extendable(false);
+    if (last && last->offset + last->length == offset) {
+      append_text(gb, offset, count);
+      last->length += count;
+    }
+    else
+      add_record(gb, offset, count, false);
+    forget_oldest();
+  }
+
+  void erasing(const GapBuffer& gb, size_type offset, size_type count) override {
+    if (replaying) return;
+    drop_redo();
+
+    record* last = extendable(true);
+    if (last && last->offset == offset) {
+      // delete key
+      append_text(gb, offset, count);
+      last->length += count;
+    }
+    else if (last && offset + count == last->offset) {
+      // backspace; the record is the newest, so its text ends the arena
+      auto first = gb.cbegin() + offset;
+      arena.insert(arena.begin() + (last->text - dropped), first, first + count);
+      last->offset = offset;
+      last->length += count;
+    }
+    else
+      add_record(gb, offset, count, true);
+    forget_oldest();
+  }
+
+  /// A buffer whose contents were replaced wholesale has no history.
+  void reset(const GapBuffer&) override {
+    if (!replaying) clear();
+  }
+
+protected:
+  /// \brief one insertion or erasure, with its elements in the arena
+  struct record {
+    size_type offset;
+    size_type length;
+    size_type text;  ///< arena position of the elements, counting dropped ones
+    bool erase;
+    bool joined;     ///< undone and redone together with the record before
+  };
+
+  template<typename F>
+  void replay(F f) {
+    replaying = true;
+    try {
+      f();
+    }
+    catch (...) {
+      replaying = false;
+      throw;
+    }
+    replaying = false;
+    sealed = true;
+  }
+
+  void insert_text(const record& r) {
+    auto first = arena.begin() + (r.text - dropped);
+    buffer.insert(buffer.cbegin() + r.offset, first, first + r.length);
+  }
+
+  void erase_text(const record& r) {
+    buffer.erase(buffer.cbegin() + r.offset, buffer.cbegin() + r.offset + r.length);
+  }
+
+  /// \return the last record if the next edit of the given kind may be
+  /// merged into it
+  record* extendable(bool erase) {
+    if (sealed || records.empty()) return nullptr;
+    record& last = records.back();
+    if (last.erase != erase || last.length >= coalesce_limit) return nullptr;
+    return &last;
+  }
+
+  void append_text(const GapBuffer& gb, size_type offset, size_type count) {
+    auto first = gb.cbegin() + offset;
+    dr::copy(first, first + count, std::back_inserter(arena));
+  }
+
+  void add_record(const GapBuffer& gb, size_type offset, size_type count, bool erase) {
+    bool joined = depth > 0 && !group_start && !records.empty();
+    records.push_back({offset, count, dropped + arena.size(), erase, joined});
+    append_text(gb, offset, count);
+    ++done;
+    group_start = false;
+    sealed = false;
+  }
+
+  /// \brief a new edit makes the undone steps unreachable
+  void drop_redo() {
+    if (!can_redo()) return;
+    arena.resize(records[done].text - dropped);
+    records.resize(done);
+  }
+
+  size_type dead_prefix() const noexcept {
+    return records.empty() ? arena.size() : records.front().text - dropped;
+  }
+
+  /// \brief drop whole steps from the front until the history fits
+  void forget_oldest() {
+    while (memory_used() > memory_limit && done > 0) {
+      do {
+        records.pop_front();
+        --done;
+      } while (done > 0 && records.front().joined);
+      if (!records.empty()) records.front().joined = false;
+    }
+
+    size_type dead = dead_prefix();
+    if (dead > arena.size() / 2) {
+      arena.erase(arena.begin(), arena.begin() + dead);
+      dropped += dead;
+    }
+  }
+
+private:
+  GapBuffer& buffer;
+  size_type memory_limit;
+  size_type coalesce_limit;
+
+  std::deque<record> records;     ///< oldest first; [0, done) can be undone
+  std::vector<value_type> arena;  ///< elements of the records, in record order
+  size_type dropped = 0;          ///< elements erased from the front of the arena
+  size_type done = 0;
+
+  size_type depth = 0;
+  bool group_start = false;
+  bool sealed = true;
+  bool replaying = false;
+};
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace dr {
+
+namespace detail {
+
+/// \brief prefix sums over a sequence of counts, with point updates
+///
+/// Decrements are added as their two's complement; the partial sums the
+/// tree stores are never negative.
+struct fenwick_tree {
+  using size_type = std::size_t;
+
+  void assign(const std::vector<size_type>& values) {
+    size_type n = values.size();
+    tree.assign(n + 1, 0);
+    for (size_type i = 1; i <= n; ++i) {
+      tree[i] += values[i - 1];
+      size_type parent = i + (i & (0 - i));
+      if (parent <= n) tree[parent] += tree[i];
+    }
+  }
+
+  /// \brief add `delta` to the value at `index`
+  void add(size_type index, size_type delta) {
+    for (size_type i = index + 1; i < tree.size(); i += i & (0 - i)) tree[i] += delta;
+  }
+
+  /// \brief the sum of the first `count` values
+  size_type prefix(size_type count) const {
+    size_type sum = 0;
+    for (size_type i = count; i > 0; i -= i & (0 - i)) sum += tree[i];
+    return sum;
+  }
+
+  /// \brief the least `count` with prefix(count) >= target, or one past
+  /// the number of values if there is none
+  size_type lower_bound(size_type target) const {
+    if (target == 0) return 0;
+
+    size_type n = tree.size() - 1;
+    size_type step = 1;
+    while (step * 2 <= n) step *= 2;
+
+    size_type pos = 0;
+    for (; step; step /= 2) {
+      if (pos + step <= n && tree[pos + step] < target) {
+        pos += step;
+        target -= tree[pos];
+      }
+    }
+    return pos + 1;
+  }
+
+  std::vector<size_type> tree;
+};
+
+}
+
+}
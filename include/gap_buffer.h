@@ -1,20 +1,73 @@
 #pragma once
 
 #include <memory>
+#include <memory_resource>
+#include <algorithm>
 #include <iterator>
 #include <cstddef>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include <utility>
 #include <gsl/gsl>
+#include "growth_policy.h"
+#include "segmented_algorithm.h"
+#ifdef DR_GAP_BUFFER_STATS
+#include "gap_buffer_stats.h"
+#endif
 
 namespace dr {
 
-/// \brief round `s` up to the nearest multiple of n
+namespace detail {
+
+/// \brief whether allocator `A` can resize an allocation in place of a
+/// fresh allocation plus copy, see mmap_allocator::reallocate
+template<typename A, typename = void>
+struct has_reallocate : std::false_type { };
+
+template<typename A>
+struct has_reallocate<A, std::void_t<decltype(std::declval<A&>().reallocate(
+    std::declval<typename std::allocator_traits<A>::pointer>(), std::size_t(), std::size_t()))>>
+    : std::true_type { };
+
+/// \brief whether allocator `A` can release unused parts of an allocation,
+/// see mmap_allocator::discard
+template<typename A, typename = void>
+struct has_discard : std::false_type { };
+
+template<typename A>
+struct has_discard<A, std::void_t<decltype(std::declval<A&>().discard(
+    std::declval<typename std::allocator_traits<A>::pointer>(), std::size_t()))>>
+    : std::true_type { };
+
+/// \brief raw storage for N elements kept inside the buffer object
+template<typename T, std::size_t N>
+struct inline_storage {
+  T* inline_data() noexcept { return reinterpret_cast<T*>(bytes); }
+  const T* inline_data() const noexcept { return reinterpret_cast<const T*>(bytes); }
+
+  alignas(T) unsigned char bytes[N * sizeof(T)];
+};
+
+/// \brief no inline storage; empty, so that it takes no space as a base
 template<typename T>
-T round_up(T s, unsigned int n) { return ((s + n - 1) / n) * n; }
+struct inline_storage<T, 0> {
+  T* inline_data() noexcept { return nullptr; }
+  const T* inline_data() const noexcept { return nullptr; }
+};
+
+}
 
-template<typename T, typename Allocator = std::allocator<T>>
-struct gap_buffer {
+/// \tparam InlineCapacity up to this many elements are stored inside the
+/// buffer object itself, see small_gap_buffer
+template<typename T,
+         typename Allocator = std::allocator<T>,
+         typename GrowthPolicy = default_growth_policy<T>,
+         std::size_t InlineCapacity = 0>
+struct gap_buffer : private detail::inline_storage<T, InlineCapacity> {
   using value_type      = T;
   using allocator_type  = Allocator;
+  using growth_policy   = GrowthPolicy;
   using size_type       = std::size_t;
   using difference_type = ptrdiff_t;
   using reference       = value_type&;
@@ -22,8 +75,53 @@ struct gap_buffer {
   using pointer         = typename std::allocator_traits<Allocator>::pointer;
   using const_pointer   = typename std::allocator_traits<Allocator>::const_pointer;
 
+  using span_type       = gsl::span<value_type>;
+  using const_span_type = gsl::span<const value_type>;
+
+  /// \brief the contiguous runs before and after the gap, in order
+  using span_pair       = std::pair<span_type, span_type>;
+  using const_span_pair = std::pair<const_span_type, const_span_type>;
+
+  /// \brief one replacement in a batch passed to apply_edits
+  struct edit {
+    size_type offset;       ///< position before any edit of the batch is applied
+    size_type erase_count;  ///< number of elements removed at `offset`
+    const_span_type text;   ///< elements inserted in their place
+  };
+
+  /// \brief observer of the edits made to a gap_buffer, see attach()
+  ///
+  /// Every change is reported as a sequence of insertions and erasures
+  /// which, applied in order, take the old contents to the new ones.
+  /// Elements written through references, iterators or spans are not
+  /// reported. reset() may be called from the noexcept move operations.
+  struct edit_listener {
+    virtual ~edit_listener() = default;
+
+    /// \brief `count` elements have been inserted at `offset`
+    virtual void inserted(const gap_buffer&, size_type /*offset*/, size_type /*count*/) { }
+
+    /// \brief the `count` elements at `offset` are about to be erased
+    virtual void erasing(const gap_buffer&, size_type /*offset*/, size_type /*count*/) { }
+
+    /// \brief the whole contents have been replaced
+    virtual void reset(const gap_buffer&) { }
+
+  private:
+    friend gap_buffer;
+    edit_listener* next_listener = nullptr;
+  };
+
+private:
+  struct at_pointer_t { };
+  static constexpr at_pointer_t at_pointer{};
+
+public:
   struct const_iterator;
 
+  /// Iterators hold a pointer straight into the storage and only consult
+  /// the container when they step across the gap. Like those of
+  /// std::vector, they are invalidated by any insertion or erasure.
   struct iterator {
     using self_type         = iterator;
     using container_type    = gap_buffer;
@@ -35,26 +133,27 @@ struct gap_buffer {
     using iterator_category = std::random_access_iterator_tag;
 
     explicit iterator(gap_buffer* container = nullptr, difference_type offset = 0)
-        : container(container), offset(offset) { }
+        : container(container),
+          ptr(container ? container->to_pointer(offset) : nullptr) { }
 
     operator const_iterator() const {
-      return const_iterator(container, offset);
+      return const_iterator(container, ptr, at_pointer);
     }
 
     reference operator [](difference_type i) const {
-      return (*container)[offset + i];
+      return *(*this + i);
     }
 
     reference operator *() const {
-      return (*container)[offset];
+      return *ptr;
     }
 
     pointer operator ->() const {
-      return &(*container)[offset];
+      return ptr;
     }
 
     self_type& operator ++() {
-      offset++;
+      if (++ptr == container->gap_start) ptr += container->gap_size;
       return *this;
     }
 
@@ -65,7 +164,8 @@ struct gap_buffer {
     }
 
     self_type& operator --() {
-      offset--;
+      if (ptr == container->gap_start + container->gap_size) ptr = container->gap_start;
+      --ptr;
       return *this;
     }
 
@@ -76,7 +176,7 @@ struct gap_buffer {
     }
 
     bool operator ==(const self_type& other) const {
-      return container == other.container && offset == other.offset;
+      return container == other.container && ptr == other.ptr;
     }
 
     bool operator !=(const self_type& other) const {
@@ -85,7 +185,7 @@ struct gap_buffer {
 
     bool operator <(const self_type& other) const {
       Expects(container == other.container);
-      return offset < other.offset;
+      return ptr < other.ptr;
     }
 
     bool operator >(const self_type& other) const {
@@ -101,41 +201,50 @@ struct gap_buffer {
     }
 
     self_type& operator +=(difference_type n) {
-      offset += n;
+      ptr = container->to_pointer(offset() + n);
       return *this;
     }
 
     friend
     self_type operator +(self_type it, difference_type n) {
-      it.offset += n;
-      return it;
+      return it += n;
     }
 
     friend
     self_type operator +(difference_type n, self_type it) {
-      it.offset += n;
-      return it;
+      return it += n;
     }
 
     self_type& operator -=(difference_type n) {
-      offset -= n;
-      return *this;
+      return *this += -n;
     }
 
     self_type operator -(difference_type n) const {
-      return self_type(container, offset - n);
+      self_type retval = *this;
+      return retval -= n;
     }
 
     difference_type operator -(const self_type& other) const {
       Expects(container == other.container);
-      return offset - other.offset;
+      return offset() - other.offset();
+    }
+
+    /// \brief [first, last) as at most two contiguous spans, see gap_buffer::segments
+    friend
+    span_pair segments(self_type first, self_type last) {
+      return first.container->segments(first, last);
     }
 
     friend class gap_buffer;
 
   private:
+    iterator(gap_buffer* container, pointer ptr, at_pointer_t)
+        : container(container), ptr(ptr) { }
+
+    difference_type offset() const { return container ? container->to_offset(ptr) : 0; }
+
     gap_buffer* container;
-    difference_type offset;
+    pointer ptr;
   };
 
   // Here we repeat ourselves, that is, DRY principle is violated.
@@ -153,22 +262,22 @@ struct gap_buffer {
 
     explicit const_iterator(const gap_buffer* container = nullptr, difference_type offset = 0)
         : container(container),
-          offset(offset) { }
+          ptr(container ? container->to_pointer(offset) : nullptr) { }
 
     reference operator [](difference_type i) const {
-      return (*container)[offset + i];
+      return *(*this + i);
     }
 
     reference operator *() const {
-      return (*container)[offset];
+      return *ptr;
     }
 
     pointer operator ->() const {
-      return &(*container)[offset];
+      return ptr;
     }
 
     self_type& operator ++() {
-      offset++;
+      if (++ptr == container->gap_start) ptr += container->gap_size;
       return *this;
     }
 
@@ -179,7 +288,8 @@ struct gap_buffer {
     }
 
     self_type& operator --() {
-      offset--;
+      if (ptr == container->gap_start + container->gap_size) ptr = container->gap_start;
+      --ptr;
       return *this;
     }
 
@@ -190,7 +300,7 @@ struct gap_buffer {
     }
 
     bool operator ==(const self_type& other) const {
-      return container == other.container && offset == other.offset;
+      return container == other.container && ptr == other.ptr;
     }
 
     bool operator !=(const self_type& other) const {
@@ -199,7 +309,7 @@ struct gap_buffer {
 
     bool operator <(const self_type& other) const {
       Expects(container == other.container);
-      return offset < other.offset;
+      return ptr < other.ptr;
     }
 
     bool operator >(const self_type& other) const {
@@ -215,95 +325,115 @@ struct gap_buffer {
     }
 
     self_type& operator +=(difference_type n) {
-      offset += n;
+      ptr = container->to_pointer(offset() + n);
       return *this;
     }
 
     friend
     self_type operator +(self_type it, difference_type n) {
-      it.offset += n;
-      return it;
+      return it += n;
     }
 
     friend
     self_type operator +(difference_type n, self_type it) {
-      it.offset += n;
-      return it;
+      return it += n;
     }
 
     self_type& operator -=(difference_type n) {
-      offset -= n;
-      return *this;
+      return *this += -n;
     }
 
     self_type operator -(difference_type n) const {
-      return self_type(container, offset - n);
+      self_type retval = *this;
+      return retval -= n;
     }
 
     difference_type operator -(const self_type& other) const {
       Expects(container == other.container);
-      return offset - other.offset;
+      return offset() - other.offset();
+    }
+
+    /// \brief [first, last) as at most two contiguous spans, see gap_buffer::segments
+    friend
+    const_span_pair segments(self_type first, self_type last) {
+      return first.container->segments(first, last);
     }
 
     friend class gap_buffer;
 
   private:
+    const_iterator(const gap_buffer* container, const_pointer ptr, at_pointer_t)
+        : container(container), ptr(ptr) { }
+
+    difference_type offset() const { return container ? container->to_offset(ptr) : 0; }
+
     const gap_buffer* container;
-    difference_type offset;
+    const_pointer ptr;
   };
 
   using reverse_iterator       = std::reverse_iterator<iterator>;
   using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
 private:
-  static constexpr float incremental_factor = 0.2;
-  static constexpr size_type default_size = 8;
-  static constexpr size_type alignment = 8;
+  /// The gap is raw memory for every T: elements are constructed when they
+  /// enter it and destroyed when they are erased, so T need not be default
+  /// constructible or copyable. Trivially copyable elements are moved with
+  /// memmove and memcpy, others one by one with their move constructor.
+  static constexpr bool trivial_elements = std::is_trivially_copyable_v<T>;
 
-public:
-  explicit gap_buffer(size_type count = default_size) {
-    if (count == 0) {
-      start = finish = gap_start = nullptr;
-      gap_size = 0;
-    }
-    else {
-      count = round_up(count, alignment);
+  /// Storage holding trivially copyable elements can be handed to
+  /// allocators that resize or trim their allocations without going
+  /// through T.
+  static constexpr bool reallocate_in_place = trivial_elements && detail::has_reallocate<Allocator>::value;
+  static constexpr bool discard_gap = trivial_elements && detail::has_discard<Allocator>::value;
+  static constexpr size_type discard_step = std::max<size_type>(1, 64 * 1024 / sizeof(T));
+
+  /// A buffer with inline storage starts out in it rather than on the heap.
+  static constexpr size_type initial_capacity =
+      InlineCapacity != 0 ? InlineCapacity : GrowthPolicy::default_capacity;
+
+  /// Moving inline elements may throw, moving heap storage does not.
+  static constexpr bool nothrow_relocatable =
+      InlineCapacity == 0 || std::is_nothrow_move_constructible_v<T>;
 
-      start = allocate_and_construct(count);
+  using alloc_traits = std::allocator_traits<Allocator>;
+
+  static constexpr bool propagate_on_move =
+      alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::is_always_equal::value;
+
+public:
+  explicit gap_buffer(size_type count = initial_capacity, const Allocator& alloc = Allocator())
+      : data_allocator(alloc) {
+    if (count != 0) {
+      start = allocate_storage(count);
       finish = start + count;
       gap_start = start;
       gap_size = count;
     }
   }
 
-  gap_buffer(size_type count, const T& value)
-      : gap_buffer(count) {
-    for (size_type i = 0; i < count; ++i) push_back(value);
+  explicit gap_buffer(const Allocator& alloc)
+      : gap_buffer(initial_capacity, alloc) { }
+
+  gap_buffer(size_type count, const T& value, const Allocator& alloc = Allocator())
+      : gap_buffer(std::max(initial_capacity, count), alloc) {
+    fill_gap(count, value);
   }
 
   template<typename InputIt>
-  gap_buffer(InputIt first, InputIt last) {
+  gap_buffer(InputIt first, InputIt last, const Allocator& alloc = Allocator())
+      : data_allocator(alloc) {
     difference_type n = std::distance(first, last);
-    size_type len = round_up(std::max(default_size, size_type(n)), alignment);
+    size_type len = std::max(initial_capacity, size_type(n));
 
-    start = data_allocator.allocate(len);
+    start = allocate_storage(len);
     finish = start + len;
 
-    int except_flag = 0;
     try {
       gap_start = std::uninitialized_copy(first, last, start);
-      except_flag = 1;
-      std::uninitialized_default_construct(gap_start, finish);
     }
     catch (...) {
-      switch (except_flag) {
-      case 1:
-        std::destroy(start, start + n);
-        // FALL THROUGH
-      case 0:
-        data_allocator.deallocate(start, finish - start);
-      default:;// DO NOTHING
-      }
+      deallocate_storage(start, len);
       throw;
     }
 
@@ -311,48 +441,144 @@ public:
   }
 
   gap_buffer(const gap_buffer& rhs)
-      : gap_buffer(rhs.begin(), rhs.end()) { }
+      : gap_buffer(rhs, alloc_traits::select_on_container_copy_construction(rhs.data_allocator)) { }
+
+  gap_buffer(const gap_buffer& rhs, const Allocator& alloc)
+      : gap_buffer(rhs.begin(), rhs.end(), alloc) { }
 
-  gap_buffer(gap_buffer&& rhs) noexcept
-      : gap_buffer(0) { swap(rhs); }
+  /// Elements held in inline storage are moved one by one; heap storage
+  /// changes hands as before.
+  gap_buffer(gap_buffer&& rhs) noexcept(nothrow_relocatable)
+      : gap_buffer(0, rhs.data_allocator) {
+    steal(rhs);
+    rhs.notify_reset();
+  }
+
+  /// The storage of `rhs` is taken over if `alloc` can free it, otherwise
+  /// its elements are moved one by one.
+  gap_buffer(gap_buffer&& rhs, const Allocator& alloc)
+      : gap_buffer(0, alloc) {
+    if (data_allocator == rhs.data_allocator)
+      steal(rhs);
+    else
+      insert(end(), std::make_move_iterator(rhs.begin()), std::make_move_iterator(rhs.end()));
+    rhs.notify_reset();
+  }
 
-  gap_buffer(std::initializer_list<T> ilist)
-      : gap_buffer(ilist.begin(), ilist.end()) { }
+  gap_buffer(std::initializer_list<T> ilist, const Allocator& alloc = Allocator())
+      : gap_buffer(ilist.begin(), ilist.end(), alloc) { }
 
+  /// The allocator of `rhs` is adopted if the allocator propagates on
+  /// copy assignment.
   gap_buffer& operator =(const gap_buffer& rhs) {
-    gap_buffer temp(rhs);
-    swap(temp);
+    if (this == &rhs) return *this;
+
+    if constexpr (alloc_traits::propagate_on_container_copy_assignment::value) {
+      gap_buffer temp(rhs, rhs.data_allocator);
+      swap_storage(temp);
+      // temp frees the old storage with the allocator it came from
+      using std::swap;
+      swap(data_allocator, temp.data_allocator);
+    }
+    else {
+      gap_buffer temp(rhs, data_allocator);
+      swap_storage(temp);
+    }
+    notify_reset();
     return *this;
   }
 
-  gap_buffer& operator =(gap_buffer&& rhs) noexcept {
-    swap(rhs);
+  /// The contents are exchanged with `rhs` when the allocator propagates
+  /// on move assignment or the two allocators are equal; otherwise the
+  /// elements of `rhs` are moved one by one into storage from this
+  /// buffer's allocator.
+  gap_buffer& operator =(gap_buffer&& rhs) noexcept(propagate_on_move && nothrow_relocatable) {
+    if (this == &rhs) return *this;
+
+    if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+      swap_storage(rhs);
+      using std::swap;
+      swap(data_allocator, rhs.data_allocator);
+    }
+    else if (alloc_traits::is_always_equal::value || data_allocator == rhs.data_allocator)
+      swap_storage(rhs);
+    else {
+      gap_buffer temp(std::make_move_iterator(rhs.begin()), std::make_move_iterator(rhs.end()), data_allocator);
+      swap_storage(temp);
+    }
+    notify_reset();
+    rhs.notify_reset();
     return *this;
   }
 
   ~gap_buffer() {
-    destroy_and_deallocate(start, finish);
+    destroy_and_deallocate();
     start = finish = gap_start = nullptr;
     gap_size = 0;
   }
 
-  void swap(gap_buffer& rhs) {
-    using std::swap;
-    swap(start, rhs.start);
-    swap(finish, rhs.finish);
-    swap(gap_start, rhs.gap_start);
-    swap(gap_size, rhs.gap_size);
+  /// Allocators are exchanged if they propagate on swap and must compare
+  /// equal otherwise. Iterators into a buffer whose elements are stored
+  /// inline do not carry over to the other buffer. Attached listeners
+  /// stay with their buffer.
+  void swap(gap_buffer& rhs) noexcept(nothrow_relocatable) {
+    if constexpr (alloc_traits::propagate_on_container_swap::value) {
+      using std::swap;
+      swap(data_allocator, rhs.data_allocator);
+    }
+    else
+      Expects(alloc_traits::is_always_equal::value || data_allocator == rhs.data_allocator);
+
+    swap_storage(rhs);
+    notify_reset();
+    rhs.notify_reset();
   }
 
-  void assign(size_type count, const T& value) { *this = gap_buffer(count, value); }
+  /// Reuses the storage when it is large enough.
+  void assign(size_type count, const T& value) {
+    if (count > capacity() || holds(value)) {
+      *this = gap_buffer(count, value, data_allocator);
+      return;
+    }
+    std::destroy(start, gap_start);
+    std::destroy(gap_start + gap_size, finish);
+    gap_start = start;
+    gap_size = capacity();
+    try {
+      fill_gap(count, value);
+    }
+    catch (...) {
+      notify_reset();
+      throw;
+    }
+    notify_reset();
+  }
 
   template<typename InputIt>
-  void assign(InputIt first, InputIt last) { *this = gap_buffer(first, last); }
+  void assign(InputIt first, InputIt last) { *this = gap_buffer(first, last, data_allocator); }
 
-  void assign(std::initializer_list<T> ilist) { *this = gap_buffer(ilist); }
+  void assign(std::initializer_list<T> ilist) { *this = gap_buffer(ilist, data_allocator); }
 
   allocator_type get_allocator() const { return data_allocator; }
 
+  /// \brief report all further edits to `listener`
+  ///
+  /// `listener` must be detached before either of them is destroyed.
+  void attach(edit_listener& listener) {
+    listener.next_listener = listeners;
+    listeners = &listener;
+  }
+
+  void detach(edit_listener& listener) {
+    for (edit_listener** p = &listeners; *p; p = &(*p)->next_listener) {
+      if (*p == &listener) {
+        *p = listener.next_listener;
+        listener.next_listener = nullptr;
+        return;
+      }
+    }
+  }
+
 
   // ------ basis START HERE ------
 
@@ -363,11 +589,22 @@ public:
 
   iterator erase(const_iterator first, const_iterator last) {
     Expects(first.container == this && last.container == this);
+    difference_type offset = first.offset();
     difference_type num_to_erase = std::distance(first, last);
-    relocate_gap(first.offset);
-    std::fill_n(gap_start + gap_size, num_to_erase, T{});
+    if (num_to_erase) notify_erasing(offset, num_to_erase);
+    relocate_gap(offset);
+    std::destroy(gap_start + gap_size, gap_start + gap_size + num_to_erase);
     gap_size += num_to_erase;
-    return iterator(this, first.offset);
+    if (is_local()) return iterator(this, offset);
+    // the whole gap, so that pages freed by a run of small erases go back
+    // too; offered again each time the gap has grown by another step
+    if constexpr (discard_gap)
+      if ((gap_size - num_to_erase) / discard_step != gap_size / discard_step)
+        data_allocator.discard(gap_start, gap_size);
+
+    size_type new_capacity = GrowthPolicy::shrink(size(), capacity());
+    if (new_capacity < capacity()) reallocate(new_capacity, offset);
+    return iterator(this, offset);
   }
 
   /// \return iterator to the first inserted element
@@ -375,58 +612,39 @@ public:
   iterator insert(const_iterator pos, InputIt first, InputIt last) {
     Expects(this == pos.container && pos <= end());
 
-    difference_type num_to_insert = std::distance(first, last);
-    if (gap_size >= num_to_insert) {
-      relocate_gap(pos.offset);
-
-      std::copy(first, last, gap_start);
-      gap_start += num_to_insert;
-      gap_size -= num_to_insert;
-      return iterator(this, pos.offset);
-    }
-    else {
-      size_type old_size = size();
-      size_type old_capacity = capacity();
-      auto default_delta = size_type(old_capacity * incremental_factor);
-      size_type delta = round_up(std::max(default_delta, num_to_insert - gap_size), alignment);
-      size_type new_capacity = std::max(old_capacity + delta, default_size);
-
-      gap_buffer temp(new_capacity);
+    difference_type offset = pos.offset();
+    size_type num_to_insert = std::distance(first, last);
+    open_gap(offset, num_to_insert);
 
-      relocate_gap(pos.offset);
-      auto cursor = std::copy(start, gap_start, temp.start);
-      cursor = std::copy(first, last, cursor);
-      std::copy(gap_start + gap_size, finish, cursor);
-
-      swap(temp);
-
-      gap_start = start + old_size + num_to_insert;
-      gap_size = finish - gap_start;
-
-      return iterator(this, pos.offset);
-    }
+    std::uninitialized_copy(first, last, gap_start);
+    gap_start += num_to_insert;
+    gap_size -= num_to_insert;
+    if (num_to_insert) notify_inserted(offset, num_to_insert);
+    return iterator(this, offset);
   }
 
   void reserve(size_type new_cap = 0) {
     if (capacity() >= new_cap) return;
     if (new_cap > max_size()) throw std::length_error("new_cap should be less than max_size()");
 
-    size_type old_size = size();
-    size_type new_capacity = round_up(new_cap, alignment);
-
-    gap_buffer temp(new_capacity);
-    auto cursor = std::copy(start, gap_start, temp.start);
-    std::copy(gap_start + gap_size, finish, cursor);
-    swap(temp);
-
-    gap_start = start + old_size;
-    gap_size = finish - gap_start;
+    reallocate(GrowthPolicy::round(new_cap), gap_start - start);
   }
 
   size_type size() const noexcept { return finish - start - gap_size; }
   size_type max_size() const noexcept { return size_type(1 << 31); }
   size_type capacity() const noexcept { return finish - start; }
 
+#ifdef DR_GAP_BUFFER_STATS
+  /// \brief what this buffer did to its storage since it was created or
+  /// the stats were last reset
+  const gap_buffer_stats& stats() const noexcept { return storage_stats; }
+
+  void reset_stats() noexcept {
+    storage_stats = gap_buffer_stats{};
+    storage_stats.allocated(capacity());
+  }
+#endif
+
   // ------ basis END HERE ------
 
   reference operator [](size_type pos) {
@@ -463,11 +681,64 @@ public:
   T* data() noexcept  = delete;
   const T* data() const noexcept = delete;
 
+  /// \brief the elements before and after the gap as two contiguous spans
+  const_span_pair segments() const noexcept { return segments(begin(), end()); }
+  span_pair segments() noexcept { return segments(begin(), end()); }
+
+  /// \brief the elements of [first, last) as at most two contiguous spans
+  ///
+  /// The first span holds the part of the range in front of the gap, the
+  /// second span the part behind it. Either of them may be empty.
+  const_span_pair segments(const_iterator first, const_iterator last) const {
+    Expects(first.container == this && last.container == this && first <= last);
+    auto[f, l] = segment_bounds(first.ptr, last.ptr);
+    return {const_span_type(f.first, f.second - f.first),
+            const_span_type(l.first, l.second - l.first)};
+  }
+
+  span_pair segments(const_iterator first, const_iterator last) {
+    Expects(first.container == this && last.container == this && first <= last);
+    auto[f, l] = segment_bounds(first.ptr, last.ptr);
+    return {span_type(f.first, f.second - f.first),
+            span_type(l.first, l.second - l.first)};
+  }
+
+  /// \brief move the gap to the end and view all elements as one span
+  ///
+  /// This costs a gap relocation, so prefer `segments()` where two spans
+  /// will do.
+  span_type contiguous_view() {
+    relocate_gap(size());
+    return span_type(start, size());
+  }
+
+  /// \brief open a gap of at least `n` elements at `pos` and return it
+  ///
+  /// The caller fills the front of the returned span in place, e.g. with
+  /// read(2), and then hands the written elements over with `commit`.
+  /// Only available where the gap is raw memory.
+  span_type prepare(const_iterator pos, size_type n) {
+    static_assert(trivial_elements, "prepare() needs a trivially copyable value_type");
+    Expects(this == pos.container);
+
+    open_gap(pos.offset(), n);
+    return span_type(gap_start, gap_size);
+  }
+
+  /// \brief make the first `n` elements of the gap part of the buffer
+  void commit(size_type n) {
+    Expects(n <= gap_size);
+    gap_start += n;
+    gap_size -= n;
+    if (n) notify_inserted(gap_start - start - n, n);
+  }
+
   [[nodiscard]] bool empty() const noexcept { return size() == 0; }
 
+  /// Elements are moved, not copied, into the smaller storage.
   void shrink_to_fit() {
-    gap_buffer temp(begin(), end());
-    swap(temp);
+    if (is_local()) return;
+    reallocate(std::max(initial_capacity, size()), gap_start - start);
   }
 
   void clear() { erase(begin(), end()); }
@@ -479,18 +750,23 @@ public:
       insert(end(), count - size(), value);
   }
 
-  iterator insert(const_iterator pos, const T& value) {
-    return insert(pos, &value, &value + 1);
-  }
+  iterator insert(const_iterator pos, const T& value) { return emplace(pos, value); }
 
-  iterator insert(const_iterator pos, T&& value) {
-    return insert(pos, std::make_move_iterator(&value), std::make_move_iterator(&value + 1));
-  }
+  iterator insert(const_iterator pos, T&& value) { return emplace(pos, std::move(value)); }
 
+  /// \brief insert `count` copies of `value`, growing and moving the gap
+  /// at most once
   iterator insert(const_iterator pos, size_type count, const T& value) {
-    for (size_type i = 0; i < count; ++i)
-      pos = insert(pos, value);
-    return iterator(this, pos.offset);
+    Expects(this == pos.container && pos <= end());
+
+    difference_type offset = pos.offset();
+    if (count == 0) return iterator(this, offset);
+    if (holds(value)) return insert(pos, count, T(value));
+
+    open_gap(offset, count);
+    fill_gap(count, value);
+    notify_inserted(offset, count);
+    return iterator(this, offset);
   }
 
   iterator insert(const_iterator pos, std::initializer_list<T> ilist) {
@@ -499,9 +775,24 @@ public:
 
   void erase(const_iterator pos) { erase(pos, pos + 1); }
 
+  /// \brief construct an element from `args` straight into the gap at `pos`
+  ///
+  /// If one of `args` is an element of this buffer, which moving the gap
+  /// or reallocating would displace, it is copied to a temporary first.
   template<typename ... Args>
   iterator emplace(const_iterator pos, Args&& ... args) {
-    return insert(pos, T(std::forward<Args>(args)...));
+    Expects(this == pos.container && pos <= end());
+
+    if ((holds(args) || ...)) return emplace(pos, T(std::forward<Args>(args)...));
+
+    difference_type offset = pos.offset();
+    open_gap(offset, 1);
+
+    ::new(static_cast<void*>(std::addressof(*gap_start))) T(std::forward<Args>(args)...);
+    ++gap_start;
+    --gap_size;
+    notify_inserted(offset, 1);
+    return iterator(this, offset);
   }
 
   template<typename ... Args>
@@ -509,8 +800,8 @@ public:
     return *emplace(end(), std::forward<Args>(args)...);
   }
 
-  void push_back(const T& value) { insert(end(), &value, &value + 1); }
-  void push_back(T&& value) { insert(end(), std::make_move_iterator(&value), std::make_move_iterator(&value + 1)); }
+  void push_back(const T& value) { emplace(end(), value); }
+  void push_back(T&& value) { emplace(end(), std::move(value)); }
   void pop_back() { erase(end() - 1); }
 
   const_iterator begin() const noexcept { return const_iterator(this); }
@@ -533,7 +824,7 @@ public:
 
   friend
   bool operator ==(const gap_buffer& lhs, const gap_buffer& rhs) {
-    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    return dr::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
   }
 
   friend
@@ -543,7 +834,7 @@ public:
 
   friend
   bool operator <(const gap_buffer& lhs, const gap_buffer& rhs) {
-    auto[left, right] = std::mismatch(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    auto[left, right] = dr::mismatch(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
 
     if (right == rhs.end()) return false;
     else if (left == lhs.end()) return true;
@@ -586,6 +877,67 @@ public:
     replace(pos, pos + 1, first, last);
   }
 
+  /// \brief apply a batch of edits in one pass over the buffer
+  ///
+  /// `edits` must be sorted by offset and must not overlap; all offsets
+  /// refer to the buffer as it is before the call. Where the gap is large
+  /// enough the edits are applied in place, front to back if the gap is
+  /// nearer the first edit and back to front if it is nearer the last one.
+  /// The gap then only moves in one direction after reaching the first
+  /// edit it meets, so the elements between the first and the last edit
+  /// move once, plus those between the gap and that edit. Otherwise the
+  /// result is assembled directly in a new allocation and the gap ends up
+  /// behind the last inserted text.
+  ///
+  /// Listeners are told about each edit as it is made, so every
+  /// notification describes the contents at that moment, as for single
+  /// edits. With listeners attached a batch which does not fit the gap
+  /// therefore grows the storage first and is then applied in place.
+  void apply_edits(gsl::span<const edit> edits) {
+    if (edits.empty()) return;
+
+    // the most the gap must hold at any point: after a prefix of the batch
+    // going forward, after a suffix going backward
+    difference_type growth = 0;
+    difference_type peak = 0;
+    difference_type trough = 0;
+    size_type previous_end = 0;
+    for (const edit& e : edits) {
+      Expects(previous_end <= e.offset && e.offset + e.erase_count <= size());
+      previous_end = e.offset + e.erase_count;
+      trough = std::min(trough, growth);
+      growth += difference_type(e.text.size()) - difference_type(e.erase_count);
+      peak = std::max(peak, growth);
+    }
+
+    size_type gap = size_type(gap_start - start);
+    size_type first = edits[0].offset;
+    bool backward = gap > first && gap - first > (gap > previous_end ? gap - previous_end : previous_end - gap);
+
+    // a batch whose later edits shrink the buffer needs no room going backward
+    difference_type forward_need = peak;
+    difference_type backward_need = std::max<difference_type>(0, growth - trough);
+    difference_type free = difference_type(gap_size);
+    if (free < (backward ? backward_need : forward_need)
+        && free >= (backward ? forward_need : backward_need))
+      backward = !backward;
+
+    if (free < (backward ? backward_need : forward_need)) {
+      size_type new_capacity = GrowthPolicy::grow(capacity(), size() + peak);
+      if (!listeners) {
+        rebuild_with_edits(edits, new_capacity);
+        return;
+      }
+      reallocate(new_capacity, first);
+      backward = false;
+    }
+
+    if (backward)
+      apply_edits_backward(edits);
+    else
+      apply_edits_forward(edits);
+  }
+
   gap_buffer substr(const_iterator first, const_iterator last) const {
     return substr_impl<gap_buffer>(first, last);
   }
@@ -594,49 +946,474 @@ protected:
 
   template<typename U>
   U substr_impl(const_iterator first, const_iterator last) const {
-    return U(first, last);
+    return U(first, last, alloc_traits::select_on_container_copy_construction(data_allocator));
+  }
+
+  /// \return [begin, end) pointer pairs of the pre-gap and post-gap parts
+  /// of the range between the iterator positions `first` and `last`
+  std::pair<std::pair<pointer, pointer>, std::pair<pointer, pointer>>
+  segment_bounds(const_pointer first, const_pointer last) const {
+    pointer gap_end = gap_start + gap_size;
+    pointer f = start + (first - start);
+    pointer l = start + (last - start);
+
+    std::pair<pointer, pointer> front(gap_start, gap_start);
+    std::pair<pointer, pointer> back(gap_end, gap_end);
+    if (f < gap_start)
+      front = {f, std::min(l, gap_start)};
+    if (l > gap_end)
+      back = {std::max(f, gap_end), l};
+    return {front, back};
+  }
+
+  /// \brief storage address of the element at logical position `offset`
+  ///
+  /// Positions at or past the gap map behind it, so the past-the-end
+  /// position is always `finish`.
+  pointer to_pointer(difference_type offset) const {
+    if (start + offset < gap_start) return start + offset;
+    else return start + offset + gap_size;
+  }
+
+  /// \brief logical position of the element stored at `p`
+  difference_type to_offset(const_pointer p) const {
+    if (p < gap_start) return p - start;
+    else return p - start - difference_type(gap_size);
+  }
+
+  /// \brief move the gap to `offset`, growing the storage first if the gap
+  /// is smaller than `n`
+  void open_gap(difference_type offset, size_type n) {
+    if (gap_size >= n)
+      relocate_gap(offset);
+    else {
+      // the new gap is opened at `offset` while moving, so the old
+      // storage does not need a gap relocation first
+      reallocate(GrowthPolicy::grow(capacity(), size() + n), offset);
+    }
+  }
+
+  /// \brief construct `count` copies of `value` at the front of the gap and
+  /// make them elements
+  void fill_gap(size_type count, const T& value) {
+    Expects(count <= gap_size);
+    if (count == 0) return;
+    if constexpr (simd::is_byte_v<T>)
+      std::memset(gap_start, static_cast<unsigned char>(value), count);
+    else
+      std::uninitialized_fill_n(gap_start, count, value);
+    gap_start += count;
+    gap_size -= count;
   }
 
   void relocate_gap(difference_type offset) {
-    if (gap_start != start + offset) {
+    record_gap_move(gap_start - start, offset);
+    if constexpr (trivial_elements) {
       if (gap_start < start + offset)
-        std::move(gap_start /**/ + gap_size,
-                  start + offset + gap_size,
-                  gap_start);
-      else
-        std::move_backward(start + offset,
-                           gap_start,
-                           gap_start + gap_size);
+        std::memmove(gap_start, gap_start + gap_size, (start + offset - gap_start) * sizeof(T));
+      else if (gap_start > start + offset)
+        std::memmove(start + offset + gap_size, start + offset, (gap_start - (start + offset)) * sizeof(T));
 
       gap_start = start + offset;
     }
+    else if (gap_size == 0)
+      gap_start = start + offset;
+    else if constexpr (std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_assignable_v<T>) {
+      // the k elements landing in the gap are constructed there, the rest
+      // are assigned, and the k slots the gap opens up are destroyed
+      pointer target = start + offset;
+      pointer gap_end = gap_start + gap_size;
+      if (target < gap_start) {
+        difference_type k = std::min<difference_type>(gap_start - target, gap_size);
+        std::uninitialized_move(gap_start - k, gap_start, gap_end - k);
+        std::move_backward(target, gap_start - k, gap_end - k);
+        std::destroy(target, target + k);
+      }
+      else if (target > gap_start) {
+        difference_type d = target - gap_start;
+        difference_type k = std::min<difference_type>(d, gap_size);
+        std::uninitialized_move(gap_end, gap_end + k, gap_start);
+        std::move(gap_end + k, gap_end + d, gap_start + k);
+        std::destroy(gap_end + d - k, gap_end + d);
+      }
+      gap_start = target;
+    }
+    else {
+      // one element at a time across the gap, so that the gap is raw
+      // memory and every element is live whenever a move throws
+      pointer target = start + offset;
+      while (gap_start > target) {
+        pointer gap_end = gap_start + gap_size;
+        ::new(static_cast<void*>(std::addressof(*(gap_end - 1)))) T(std::move_if_noexcept(*(gap_start - 1)));
+        std::destroy_at(std::addressof(*--gap_start));
+      }
+      while (gap_start < target) {
+        pointer gap_end = gap_start + gap_size;
+        ::new(static_cast<void*>(std::addressof(*gap_start))) T(std::move_if_noexcept(*gap_end));
+        std::destroy_at(std::addressof(*gap_end));
+        ++gap_start;
+      }
+    }
+  }
+
+  /// \brief move the elements into a fresh allocation of `new_capacity`
+  /// elements, opening the gap at `offset` on the way
+  ///
+  /// Each element is transferred exactly once, straight from its place
+  /// around the old gap to its place around the new one.
+  void reallocate(size_type new_capacity, difference_type offset) {
+    size_type n = size();
+    Expects(new_capacity >= n);
+
+    if constexpr (reallocate_in_place) {
+      if (start && !is_local() && new_capacity >= capacity()) {
+        grow_in_place(new_capacity, offset);
+        return;
+      }
+    }
+
+    pointer pos = to_pointer(offset);
+    auto[front1, back1] = segment_bounds(to_pointer(0), pos);
+    auto[front2, back2] = segment_bounds(pos, finish);
+
+    pointer new_start = allocate_storage(new_capacity);
+    pointer new_finish = new_start + new_capacity;
+    pointer new_gap_start = new_start + offset;
+    pointer new_gap_end = new_finish - (n - offset);
+
+    pointer prefix_end = new_start;
+    pointer suffix_end = new_gap_end;
+    try {
+      prefix_end = uninitialized_transfer(front1.first, front1.second, prefix_end);
+      prefix_end = uninitialized_transfer(back1.first, back1.second, prefix_end);
+      suffix_end = uninitialized_transfer(front2.first, front2.second, suffix_end);
+      suffix_end = uninitialized_transfer(back2.first, back2.second, suffix_end);
+    }
+    catch (...) {
+      std::destroy(new_start, prefix_end);
+      std::destroy(new_gap_end, suffix_end);
+      deallocate_storage(new_start, new_capacity);
+      throw;
+    }
+
+    record_reallocation(new_capacity, n);
+    destroy_and_deallocate();
+    start = new_start;
+    finish = new_finish;
+    gap_start = new_gap_start;
+    gap_size = new_gap_end - new_gap_start;
+  }
+
+  void notify_inserted(size_type offset, size_type count) const {
+    for (edit_listener* l = listeners; l; l = l->next_listener) l->inserted(*this, offset, count);
+  }
+
+  void notify_erasing(size_type offset, size_type count) const {
+    for (edit_listener* l = listeners; l; l = l->next_listener) l->erasing(*this, offset, count);
+  }
+
+  void notify_reset() const {
+    for (edit_listener* l = listeners; l; l = l->next_listener) l->reset(*this);
+  }
+
+  /// \brief exchange contents without telling the listeners
+  void swap_storage(gap_buffer& rhs) noexcept(nothrow_relocatable) {
+    if (!is_local() && !rhs.is_local()) {
+      using std::swap;
+      swap(start, rhs.start);
+      swap(finish, rhs.finish);
+      swap(gap_start, rhs.gap_start);
+      swap(gap_size, rhs.gap_size);
+    }
+    else {
+      gap_buffer temp(0, data_allocator);
+      temp.steal(*this);
+      steal(rhs);
+      rhs.steal(temp);
+    }
+  }
+
+  /// \brief apply_edits front to back when the gap can hold the growth of
+  /// every prefix of the batch
+  ///
+  /// The gap moves forward from edit to edit and ends up behind the last
+  /// inserted text.
+  void apply_edits_forward(gsl::span<const edit> edits) {
+    difference_type shift = 0;
+    for (const edit& e : edits) {
+      size_type offset = e.offset + shift;
+      if (e.erase_count) notify_erasing(offset, e.erase_count);
+      relocate_gap(offset);
+      std::destroy(gap_start + gap_size, gap_start + gap_size + e.erase_count);
+      gap_size += e.erase_count;
+
+      std::uninitialized_copy(e.text.data(), e.text.data() + e.text.size(), gap_start);
+      gap_start += e.text.size();
+      gap_size -= e.text.size();
+      if (!e.text.empty()) notify_inserted(offset, e.text.size());
+      shift += difference_type(e.text.size()) - difference_type(e.erase_count);
+    }
+  }
+
+  /// \brief apply_edits back to front when the gap can hold the growth of
+  /// every suffix of the batch
+  ///
+  /// Everything in front of an edit is still where it was, so its offset
+  /// needs no shift. The gap moves backward from edit to edit, each text is
+  /// placed at the back of the gap so that it stays behind it, and the gap
+  /// ends up in front of the first inserted text.
+  void apply_edits_backward(gsl::span<const edit> edits) {
+    for (size_type i = edits.size(); i-- > 0;) {
+      const edit& e = edits[i];
+      if (e.erase_count) notify_erasing(e.offset, e.erase_count);
+      relocate_gap(e.offset + e.erase_count);
+      std::destroy(gap_start - e.erase_count, gap_start);
+      gap_start -= e.erase_count;
+      gap_size += e.erase_count;
+
+      std::uninitialized_copy(e.text.data(), e.text.data() + e.text.size(), gap_start + (gap_size - e.text.size()));
+      gap_size -= e.text.size();
+      if (!e.text.empty()) notify_inserted(e.offset, e.text.size());
+    }
+  }
+
+  /// \brief assemble the result of apply_edits in a new allocation
+  ///
+  /// Unchanged runs are transferred and inserted texts copied straight to
+  /// their final place; the gap is opened behind the last text.
+  void rebuild_with_edits(gsl::span<const edit> edits, size_type new_capacity) {
+    size_type old_size = size();
+    size_type tail_offset = edits[edits.size() - 1].offset + edits[edits.size() - 1].erase_count;
+    size_type tail_length = old_size - tail_offset;
+
+    pointer new_start = allocate_storage(new_capacity);
+    pointer new_finish = new_start + new_capacity;
+    pointer cursor = new_start;
+    pointer tail_start = new_finish - tail_length;
+    pointer tail_end = tail_start;
+
+    auto transfer_run = [&](size_type first, size_type last, pointer dest) {
+      auto[front, back] = segment_bounds(to_pointer(first), to_pointer(last));
+      dest = uninitialized_transfer(front.first, front.second, dest);
+      return uninitialized_transfer(back.first, back.second, dest);
+    };
+
+    try {
+      size_type copied_up_to = 0;
+      for (const edit& e : edits) {
+        cursor = transfer_run(copied_up_to, e.offset, cursor);
+        if constexpr (trivial_elements) {
+          if (!e.text.empty()) std::memcpy(cursor, e.text.data(), e.text.size() * sizeof(T));
+          cursor += e.text.size();
+        }
+        else
+          cursor = std::uninitialized_copy(e.text.data(), e.text.data() + e.text.size(), cursor);
+        copied_up_to = e.offset + e.erase_count;
+      }
+      tail_end = transfer_run(tail_offset, old_size, tail_start);
+    }
+    catch (...) {
+      std::destroy(new_start, cursor);
+      std::destroy(tail_start, tail_end);
+      deallocate_storage(new_start, new_capacity);
+      throw;
+    }
+
+    record_reallocation(new_capacity, (cursor - new_start) + tail_length);
+    destroy_and_deallocate();
+    start = new_start;
+    finish = new_finish;
+    gap_start = cursor;
+    gap_size = tail_start - cursor;
+  }
+
+  /// \brief grow the storage through Allocator::reallocate and open the
+  /// gap at `offset`
+  ///
+  /// The prefix before `offset` stays where it is; only the elements behind
+  /// `offset` are moved, each once, to the end of the enlarged storage.
+  void grow_in_place(size_type new_capacity, difference_type offset) {
+    size_type n = size();
+    difference_type old_gap = gap_start - start;
+    size_type old_gap_size = gap_size;
+    record_reallocation(new_capacity, n - size_type(std::min(offset, old_gap)));
+
+    start = data_allocator.reallocate(start, capacity(), new_capacity);
+    finish = start + new_capacity;
+    pointer new_gap_end = finish - (n - offset);
+
+    if (offset <= old_gap) {
+      // [offset, old_gap) and everything behind the old gap move right
+      std::memmove(new_gap_end + (old_gap - offset), start + old_gap + old_gap_size,
+                   (n - old_gap) * sizeof(T));
+      std::memmove(new_gap_end, start + offset, (old_gap - offset) * sizeof(T));
+    }
+    else {
+      // the part of the old suffix in front of `offset` closes up to the
+      // left, the rest moves to the end
+      std::memmove(start + old_gap, start + old_gap + old_gap_size, (offset - old_gap) * sizeof(T));
+      std::memmove(new_gap_end, start + offset + old_gap_size, (n - offset) * sizeof(T));
+    }
+
+    gap_start = start + offset;
+    gap_size = new_gap_end - gap_start;
+  }
+
+  /// \brief move-construct [first, last) into raw storage at `dest`
+  ///
+  /// Falls back to copying when a move could throw and a copy is
+  /// available, as std::move_if_noexcept does.
+  static pointer uninitialized_transfer(pointer first, pointer last, pointer dest) {
+    if constexpr (trivial_elements) {
+      if (first != last) std::memcpy(dest, first, (last - first) * sizeof(T));
+      return dest + (last - first);
+    }
+    else if constexpr (std::is_nothrow_move_constructible_v<T> || !std::is_copy_constructible_v<T>)
+      return std::uninitialized_move(first, last, dest);
+    else
+      return std::uninitialized_copy(first, last, dest);
+  }
+
+  /// \brief storage for at least `n` elements; `n` is updated to the
+  /// capacity actually obtained
+  ///
+  /// The inline storage is handed out when it is large enough and does not
+  /// hold the current elements, so a buffer that shrinks back under
+  /// InlineCapacity moves back into it.
+  pointer allocate_storage(size_type& n) {
+    if constexpr (InlineCapacity != 0) {
+      if (n <= InlineCapacity && !is_local()) {
+        n = InlineCapacity;
+        return this->inline_data();
+      }
+    }
+    n = GrowthPolicy::round(n);
+    record_allocation(n);
+    return data_allocator.allocate(n);
   }
 
-  pointer allocate_and_construct(size_type n) {
-    pointer result = data_allocator.allocate(n);
-    std::uninitialized_default_construct_n(result, n);
-    return result;
+  void deallocate_storage(pointer p, size_type n) {
+    if (InlineCapacity != 0 && p == this->inline_data()) return;
+    data_allocator.deallocate(p, n);
   }
 
-  void destroy_and_deallocate(pointer start, pointer finish) {
-    std::destroy(start, finish);
+  /// \brief count a move of the gap from offset `from` to `to`, when stats
+  /// are enabled
+  void record_gap_move([[maybe_unused]] difference_type from, [[maybe_unused]] difference_type to) {
+#ifdef DR_GAP_BUFFER_STATS
+    storage_stats.gap_moved(this, size_type(from), size_type(to));
+#endif
+  }
+
+  /// \brief count a move of `moved` elements into storage of
+  /// `new_capacity`, before the old storage is released
+  void record_reallocation([[maybe_unused]] size_type new_capacity, [[maybe_unused]] size_type moved) {
+#ifdef DR_GAP_BUFFER_STATS
+    storage_stats.reallocated(this, capacity(), new_capacity, moved * sizeof(T));
+#endif
+  }
+
+  void record_allocation([[maybe_unused]] size_type n) noexcept {
+#ifdef DR_GAP_BUFFER_STATS
+    storage_stats.allocated(n);
+#endif
+  }
+
+  bool is_local() const noexcept { return InlineCapacity != 0 && start == this->inline_data(); }
+
+  /// \brief take over the elements of `rhs`, leaving it without storage
+  ///
+  /// `*this` must have no storage of its own.
+  void steal(gap_buffer& rhs) noexcept(nothrow_relocatable) {
+    if (rhs.is_local()) {
+      // the elements keep their places around the gap
+      pointer local = this->inline_data();
+      pointer rhs_gap_end = rhs.gap_start + rhs.gap_size;
+      uninitialized_transfer(rhs.start, rhs.gap_start, local);
+      uninitialized_transfer(rhs_gap_end, rhs.finish, local + (rhs_gap_end - rhs.start));
+      std::destroy(rhs.start, rhs.gap_start);
+      std::destroy(rhs_gap_end, rhs.finish);
+      start = local;
+      finish = local + (rhs.finish - rhs.start);
+      gap_start = local + (rhs.gap_start - rhs.start);
+    }
+    else {
+      start = rhs.start;
+      finish = rhs.finish;
+      gap_start = rhs.gap_start;
+    }
+    gap_size = rhs.gap_size;
+    rhs.start = rhs.finish = rhs.gap_start = nullptr;
+    rhs.gap_size = 0;
+  }
+
+  /// \brief whether `arg` is one of the elements
+  template<typename U>
+  bool holds(const U& arg) const noexcept {
+    if constexpr (std::is_same_v<U, T>) {
+      if (!start) return false;
+      std::less<const T*> before;
+      const T* first = std::addressof(*start);
+      return !before(std::addressof(arg), first) && before(std::addressof(arg), first + capacity());
+    }
+    else
+      return false;
+  }
+
+  /// \brief destroy the elements and release the storage
+  void destroy_and_deallocate() {
+    std::destroy(start, gap_start);
+    std::destroy(gap_start + gap_size, finish);
     if (start)
-      data_allocator.deallocate(start, finish - start);
+      deallocate_storage(start, finish - start);
   }
 
 private:
   Allocator data_allocator;
 
-  pointer start;
-  pointer finish;
-  pointer gap_start;
-  size_type gap_size;
+  // empty until a constructor allocates; allocate_storage() reads `start`
+  // to tell whether the inline storage is in use
+  pointer start = nullptr;
+  pointer finish = nullptr;
+  pointer gap_start = nullptr;
+  size_type gap_size = 0;
+
+  edit_listener* listeners = nullptr;
+
+#ifdef DR_GAP_BUFFER_STATS
+  gap_buffer_stats storage_stats;
+#endif
 };
 
-template<typename T, typename Allocator>
-void swap(gap_buffer<T, Allocator>& lhs, gap_buffer<T, Allocator>& rhs) {
+template<typename T, typename Allocator, typename GrowthPolicy, std::size_t InlineCapacity>
+void swap(gap_buffer<T, Allocator, GrowthPolicy, InlineCapacity>& lhs,
+          gap_buffer<T, Allocator, GrowthPolicy, InlineCapacity>& rhs) noexcept(noexcept(lhs.swap(rhs))) {
   lhs.swap(rhs);
 }
 
+/// \brief gap_buffer that keeps up to N elements inside the object and only
+/// allocates once it outgrows them
+///
+/// Meant for large numbers of short buffers. Moving or swapping a buffer
+/// whose elements are inline moves the elements, like std::string's small
+/// string optimization.
+template<typename T,
+         std::size_t N,
+         typename Allocator = std::allocator<T>,
+         typename GrowthPolicy = default_growth_policy<T>>
+using small_gap_buffer = gap_buffer<T, Allocator, GrowthPolicy, N>;
+
+namespace pmr {
+
+/// \brief gap_buffer drawing its storage from a std::pmr::memory_resource
+///
+/// The resource stays with the buffer: a copy-constructed buffer uses the
+/// default resource, and assigning between buffers on different resources
+/// copies or moves the elements instead of the storage. See
+/// gap_buffer_arena for a resource suited to many short-lived buffers.
+template<typename T, typename GrowthPolicy = default_growth_policy<T>>
+using gap_buffer = dr::gap_buffer<T, std::pmr::polymorphic_allocator<T>, GrowthPolicy>;
+
+}
 
 }
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+
+namespace dr {
+
+namespace pmr {
+
+/// \brief memory resource for many short-lived, growing gap_buffers
+///
+/// Blocks come in size classes four to a power of two, from 64 bytes up
+/// to `max_block`: 64, 80, 96, 112, 128, 160, ... Their spacing is close
+/// to the 20% steps of default_growth_policy, so a buffer growing step by
+/// step walks up the classes. A freed block goes on the free list of its
+/// class for the next buffer of that size, and new blocks are carved from
+/// chunks which double in size as the arena fills up.
+///
+/// Larger or over-aligned requests are passed to the upstream resource.
+/// release() hands all chunks back at once, which makes a per-request
+/// arena as cheap to clear as a monotonic_buffer_resource. Like
+/// std::pmr::unsynchronized_pool_resource it is not thread-safe.
+struct gap_buffer_arena : std::pmr::memory_resource {
+  static constexpr std::size_t min_block = 64;
+  static constexpr std::size_t max_block = std::size_t(1) << 20;
+
+  explicit gap_buffer_arena(std::pmr::memory_resource* upstream = std::pmr::get_default_resource(),
+                            std::size_t initial_chunk = std::size_t(64) << 10)
+      : upstream(upstream),
+        initial_chunk(round_to_blocks(std::max(initial_chunk, min_block))),
+        next_chunk(this->initial_chunk) { }
+
+  gap_buffer_arena(const gap_buffer_arena&) = delete;
+  gap_buffer_arena& operator =(const gap_buffer_arena&) = delete;
+
+  ~gap_buffer_arena() override { release(); }
+
+  /// \brief free all blocks at once, whether deallocated or not
+  ///
+  /// Blocks handed straight to the upstream resource are not affected.
+  void release() noexcept {
+    while (chunks) {
+      chunk* c = chunks;
+      chunks = c->next;
+      upstream->deallocate(c, c->size, alignof(chunk));
+    }
+    free_lists.fill(nullptr);
+    cursor = limit = nullptr;
+    next_chunk = initial_chunk;
+    chunk_bytes = 0;
+  }
+
+  std::pmr::memory_resource* upstream_resource() const noexcept { return upstream; }
+
+  /// \return bytes currently held from the upstream resource in chunks
+  std::size_t reserved() const noexcept { return chunk_bytes; }
+
+  /// \brief the block size serving a request of `bytes`
+  static constexpr std::size_t block_size(std::size_t bytes) noexcept {
+    return class_size(size_class(bytes));
+  }
+
+protected:
+  static constexpr std::size_t min_shift = 6;
+  static constexpr std::size_t classes = 4 * (20 - min_shift) + 1;
+
+  static_assert(min_block == std::size_t(1) << min_shift);
+  static_assert(max_block == std::size_t(1) << (min_shift + (classes - 1) / 4));
+
+  struct alignas(std::max_align_t) chunk {
+    chunk* next;
+    std::size_t size;
+  };
+
+  struct free_block {
+    free_block* next;
+  };
+
+  static constexpr unsigned log2(std::size_t n) noexcept {
+    unsigned k = 0;
+    while (n >>= 1) ++k;
+    return k;
+  }
+
+  /// Class 4(k - 6) + q holds blocks of 2^k + q 2^(k-2) bytes.
+  static constexpr std::size_t size_class(std::size_t bytes) noexcept {
+    if (bytes <= min_block) return 0;
+    unsigned k = log2(bytes - 1);
+    std::size_t base = std::size_t(1) << k;
+    std::size_t quarter = base >> 2;
+    return 4 * (k - min_shift) + (bytes - base + quarter - 1) / quarter;
+  }
+
+  static constexpr std::size_t class_size(std::size_t c) noexcept {
+    std::size_t base = std::size_t(1) << (min_shift + c / 4);
+    return base + c % 4 * (base >> 2);
+  }
+
+  static constexpr std::size_t round_to_blocks(std::size_t bytes) noexcept {
+    constexpr std::size_t a = alignof(std::max_align_t);
+    return (bytes + a - 1) / a * a;
+  }
+
+  static bool pooled(std::size_t bytes, std::size_t alignment) noexcept {
+    return bytes <= max_block && alignment <= alignof(std::max_align_t);
+  }
+
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    if (!pooled(bytes, alignment)) return upstream->allocate(bytes, alignment);
+
+    std::size_t c = size_class(bytes);
+    if (free_block* b = free_lists[c]) {
+      free_lists[c] = b->next;
+      return b;
+    }
+
+    std::size_t size = class_size(c);
+    if (std::size_t(limit - cursor) < size) refill(size);
+    void* p = cursor;
+    cursor += size;
+    return p;
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+    if (!pooled(bytes, alignment)) {
+      upstream->deallocate(p, bytes, alignment);
+      return;
+    }
+    push(p, size_class(bytes));
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+  void push(void* p, std::size_t c) noexcept {
+    free_lists[c] = ::new (p) free_block{free_lists[c]};
+  }
+
+  /// \brief start a new chunk with room for at least `size` bytes
+  ///
+  /// What is left of the current chunk goes to the free lists of the
+  /// largest classes that fit.
+  void refill(std::size_t size) {
+    std::size_t bytes = std::max(next_chunk, size + sizeof(chunk));
+    chunk* c = ::new (upstream->allocate(bytes, alignof(chunk))) chunk{chunks, bytes};
+    chunks = c;
+    chunk_bytes += bytes;
+    next_chunk = std::min(2 * next_chunk, std::size_t(16) * max_block);
+
+    for (std::size_t left = std::size_t(limit - cursor); left >= min_block; left = std::size_t(limit - cursor)) {
+      std::size_t k = std::min(size_class(left), classes - 1);
+      if (class_size(k) > left) --k;
+      push(cursor, k);
+      cursor += class_size(k);
+    }
+
+    cursor = reinterpret_cast<std::byte*>(c + 1);
+    limit = reinterpret_cast<std::byte*>(c) + bytes;
+  }
+
+private:
+  std::pmr::memory_resource* upstream;
+  std::size_t initial_chunk;
+  std::size_t next_chunk;
+  std::size_t chunk_bytes = 0;
+  chunk* chunks = nullptr;
+  std::byte* cursor = nullptr;
+  std::byte* limit = nullptr;
+  std::array<free_block*, classes> free_lists{};
+};
+
+}
+
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "gap_buffer.h"
+
+namespace dr {
+
+namespace detail {
+
+[[noreturn]] inline void throw_errno(const char* what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+}
+
+/// \brief read everything from `fd` up to end of file into `gb` at `pos`
+///
+/// The data is read straight into the gap; the buffer is grown once up
+/// front when `fd` is a regular file and as needed otherwise.
+/// \return the number of bytes read
+template<typename T, typename Allocator, typename GrowthPolicy, std::size_t InlineCapacity>
+std::size_t load_from_fd(int fd, gap_buffer<T, Allocator, GrowthPolicy, InlineCapacity>& gb,
+                         typename gap_buffer<T, Allocator, GrowthPolicy, InlineCapacity>::const_iterator pos) {
+  static_assert(sizeof(T) == 1, "file I/O works on byte buffers");
+
+  constexpr std::size_t chunk_size = 64 * 1024;
+  std::size_t expected = 0;  // bytes left according to fstat
+  struct stat st{};
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    if (offset >= 0 && st.st_size > offset) expected = std::size_t(st.st_size - offset);
+  }
+
+  auto offset = pos - gb.cbegin();
+  std::size_t total = 0;
+  for (;;) {
+    // one byte past the expected size lets the read at end of file land in
+    // the gap already open instead of growing the buffer again
+    std::size_t hint = expected && total <= expected ? expected - total + 1 : chunk_size;
+    auto gap = gb.prepare(gb.cbegin() + offset, hint);
+    ssize_t n = ::read(fd, gap.data(), gap.size());
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      detail::throw_errno("read");
+    }
+    if (n == 0) break;
+
+    gb.commit(std::size_t(n));
+    offset += n;
+    total += std::size_t(n);
+  }
+  return total;
+}
+
+/// \brief append everything from `fd` up to end of file to `gb`
+template<typename T, typename Allocator, typename GrowthPolicy, std::size_t InlineCapacity>
+std::size_t load_from_fd(int fd, gap_buffer<T, Allocator, GrowthPolicy, InlineCapacity>& gb) {
+  return load_from_fd(fd, gb, gb.cend());
+}
+
+namespace detail {
+
+/// \brief write the spans in `iov` completely, resuming after short writes
+inline void write_all(int fd, iovec* iov, int count) {
+  while (count > 0) {
+    ssize_t n = ::writev(fd, iov, count);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      throw_errno("writev");
+    }
+
+    auto written = std::size_t(n);
+    while (count > 0 && written >= iov->iov_len) {
+      written -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+    if (count > 0) {
+      iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+      iov->iov_len -= written;
+    }
+  }
+}
+
+}
+
+/// \brief write the contents of `gb` to `fd` with a single writev of both
+/// segments
+template<typename T, typename Allocator, typename GrowthPolicy, std::size_t InlineCapacity>
+void save_to_fd(int fd, const gap_buffer<T, Allocator, GrowthPolicy, InlineCapacity>& gb) {
+  static_assert(sizeof(T) == 1, "file I/O works on byte buffers");
+
+  auto[front, back] = gb.segments();
+  iovec iov[2] = {{const_cast<T*>(front.data()), front.size()},
+                  {const_cast<T*>(back.data()), back.size()}};
+  detail::write_all(fd, iov, 2);
+}
+
+/// \brief a file mapped read-only which turns into a gap_buffer on the
+/// first edit
+///
+/// Until `edit()` is called the contents are read straight from a private
+/// mapping of the file and nothing is copied; `edit()` copies them into a
+/// `GapBuffer` once and drops the mapping.
+template<typename GapBuffer = gap_buffer<char>>
+class basic_mapped_buffer {
+public:
+  using buffer_type     = GapBuffer;
+  using value_type      = typename buffer_type::value_type;
+  using size_type       = typename buffer_type::size_type;
+  using const_reference = typename buffer_type::const_reference;
+  using const_span_type = typename buffer_type::const_span_type;
+  using const_span_pair = typename buffer_type::const_span_pair;
+
+  static_assert(sizeof(value_type) == 1, "file I/O works on byte buffers");
+
+  /// \brief map the whole of the regular file open on `fd`
+  explicit basic_mapped_buffer(int fd) : buffer(0) {
+    struct stat st{};
+    if (fstat(fd, &st) != 0) detail::throw_errno("fstat");
+
+    length = size_type(st.st_size);
+    if (length == 0) return;
+
+    void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) detail::throw_errno("mmap");
+    mapping = static_cast<const value_type*>(p);
+  }
+
+  basic_mapped_buffer(const basic_mapped_buffer&) = delete;
+  basic_mapped_buffer& operator =(const basic_mapped_buffer&) = delete;
+
+  ~basic_mapped_buffer() { unmap(); }
+
+  /// \brief whether the contents have been copied into the gap buffer
+  bool materialized() const noexcept { return !mapping; }
+
+  size_type size() const noexcept { return mapping ? length : buffer.size(); }
+  [[nodiscard]] bool empty() const noexcept { return size() == 0; }
+
+  const_reference operator [](size_type pos) const {
+    if (mapping) return mapping[pos];
+    else return buffer[pos];
+  }
+
+  const_span_pair segments() const {
+    if (mapping) return {const_span_type(mapping, length), const_span_type()};
+    else return buffer.segments();
+  }
+
+  /// \brief the editable gap buffer, copied out of the mapping on first use
+  buffer_type& edit() {
+    if (mapping) {
+      madvise(const_cast<value_type*>(mapping), length, MADV_SEQUENTIAL);
+      buffer_type materialized(0);
+      auto gap = materialized.prepare(materialized.cend(), length);
+      std::memcpy(gap.data(), mapping, length);
+      materialized.commit(length);
+      buffer.swap(materialized);
+      unmap();
+    }
+    return buffer;
+  }
+
+  void save_to_fd(int fd) const {
+    if (mapping) {
+      iovec iov[1] = {{const_cast<value_type*>(mapping), length}};
+      detail::write_all(fd, iov, 1);
+    }
+    else dr::save_to_fd(fd, buffer);
+  }
+
+private:
+  void unmap() noexcept {
+    if (mapping) munmap(const_cast<value_type*>(mapping), length);
+    mapping = nullptr;
+  }
+
+  const value_type* mapping = nullptr;
+  size_type length = 0;
+  buffer_type buffer;
+};
+
+using mapped_buffer = basic_mapped_buffer<>;
+
+}
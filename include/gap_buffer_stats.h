@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace dr {
+
+/// \brief receives a gap_buffer's storage events as they happen
+///
+/// Install one with set_trace_sink(). Events are only produced when the
+/// library is built with DR_GAP_BUFFER_STATS defined, and may come from
+/// every thread that edits a buffer.
+struct gap_buffer_trace_sink {
+  virtual ~gap_buffer_trace_sink() = default;
+
+  /// \brief the gap of `buffer` moved from offset `from` to `to`
+  virtual void gap_moved(const void* /*buffer*/, std::size_t /*from*/, std::size_t /*to*/) { }
+
+  /// \brief `buffer` moved to new storage, copying `bytes_copied` bytes
+  virtual void reallocated(const void* /*buffer*/, std::size_t /*old_capacity*/,
+                           std::size_t /*new_capacity*/, std::size_t /*bytes_copied*/) { }
+};
+
+namespace detail {
+
+inline std::atomic<gap_buffer_trace_sink*> trace_sink{nullptr};
+
+}
+
+/// \brief send the events of all buffers to `sink`, or nowhere if null
+/// \return the sink installed before
+inline gap_buffer_trace_sink* set_trace_sink(gap_buffer_trace_sink* sink) noexcept {
+  return detail::trace_sink.exchange(sink);
+}
+
+/// \brief counts of what a gap_buffer did to its storage
+///
+/// Kept by every gap_buffer when DR_GAP_BUFFER_STATS is defined before
+/// gap_buffer.h is included; without it the buffers carry neither the
+/// counters nor the code updating them. Define it the same way in every
+/// translation unit of a program.
+struct gap_buffer_stats {
+  std::uint64_t gap_relocations = 0;  ///< calls to move the gap, including ones where it stayed
+  std::uint64_t elements_moved = 0;   ///< elements shifted by those calls
+  std::uint64_t reallocations = 0;
+  std::uint64_t bytes_copied = 0;     ///< bytes moved into new storage by reallocations
+  std::size_t peak_capacity = 0;
+
+  double average_gap_distance() const noexcept {
+    return gap_relocations ? double(elements_moved) / double(gap_relocations) : 0.0;
+  }
+
+  void gap_moved(const void* buffer, std::size_t from, std::size_t to) {
+    ++gap_relocations;
+    if (from == to) return;
+    elements_moved += from < to ? to - from : from - to;
+    if (auto sink = detail::trace_sink.load(std::memory_order_relaxed)) sink->gap_moved(buffer, from, to);
+  }
+
+  void reallocated(const void* buffer, std::size_t old_capacity, std::size_t new_capacity,
+                   std::size_t bytes) {
+    ++reallocations;
+    bytes_copied += bytes;
+    allocated(new_capacity);
+    if (auto sink = detail::trace_sink.load(std::memory_order_relaxed))
+      sink->reallocated(buffer, old_capacity, new_capacity, bytes);
+  }
+
+  void allocated(std::size_t capacity) noexcept { peak_capacity = std::max(peak_capacity, capacity); }
+};
+
+}
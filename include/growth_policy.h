@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+namespace dr {
+
+/// \brief round `s` up to the nearest multiple of n
+template<typename T>
+T round_up(T s, unsigned int n) { return ((s + n - 1) / n) * n; }
+
+/// \brief growth and shrink policy for gap_buffer
+///
+/// A growth policy provides
+///  - `default_capacity`, the capacity of a default-constructed buffer,
+///  - `round(n)`, the capacity actually allocated when n is asked for,
+///  - `grow(capacity, required)`, the new capacity once `required`
+///    elements no longer fit in `capacity`,
+///  - `shrink(size, capacity)`, the capacity to trim to after an erase;
+///    returning `capacity` keeps the storage.
+///
+/// \tparam GrowthPercent  growth step in percent of the current capacity
+/// \tparam MinCapacity    smallest capacity ever allocated
+/// \tparam Alignment      capacities are rounded to this many bytes
+/// \tparam MinGap         minimum gap left free after growing
+/// \tparam ShrinkPercent  shrink once the buffer is less than this full,
+///                        0 to never shrink automatically
+template<typename T,
+         std::size_t GrowthPercent,
+         std::size_t MinCapacity,
+         std::size_t Alignment,
+         std::size_t MinGap = 0,
+         std::size_t ShrinkPercent = 0>
+struct basic_growth_policy {
+  static constexpr std::size_t default_capacity = MinCapacity;
+
+  static std::size_t round(std::size_t n) {
+    constexpr unsigned int elements = std::max<std::size_t>(1, Alignment / sizeof(T));
+    return round_up(n, elements);
+  }
+
+  static std::size_t grow(std::size_t capacity, std::size_t required) {
+    std::size_t step = capacity / 100 * GrowthPercent + capacity % 100 * GrowthPercent / 100;
+    return round(std::max({capacity + step, required + MinGap, MinCapacity}));
+  }
+
+  /// Shrinking leaves a full growth step of headroom, so that an erase
+  /// followed by a few inserts does not bounce between two capacities.
+  static std::size_t shrink(std::size_t size, std::size_t capacity) {
+    if (ShrinkPercent == 0 || size >= capacity / 100 * ShrinkPercent) return capacity;
+
+    std::size_t target = grow(size, size);
+    return target < capacity ? target : capacity;
+  }
+};
+
+/// \brief modest 20% steps in multiples of 8 elements, never shrinks
+template<typename T>
+using default_growth_policy = basic_growth_policy<T, 20, 8, 8 * sizeof(T)>;
+
+/// \brief std::vector-like doubling on cache-line boundaries, shrinks
+/// below a quarter full
+template<typename T>
+using geometric_growth_policy = basic_growth_policy<T, 100, 16, 64, 0, 25>;
+
+/// \brief tight fit for many small scratch buffers, shrinks below half full
+template<typename T>
+using compact_growth_policy = basic_growth_policy<T, 25, 4, sizeof(T), 0, 50>;
+
+/// \brief page-granular growth for very large buffers, keeps at least a
+/// page-sized gap and hands memory back below a quarter full
+template<typename T>
+using page_growth_policy = basic_growth_policy<T, 50, 4096 / sizeof(T), 4096, 4096 / sizeof(T), 25>;
+
+}
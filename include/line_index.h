@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include <gsl/gsl>
+#include "fenwick_tree.h"
+#include "gap_buffer.h"
+
+namespace dr {
+
+/// \brief line numbers of a byte gap_buffer, kept up to date as it is
+/// edited
+///
+/// The text is covered by consecutive blocks of around `block_size`
+/// elements, each knowing its length and how many line feeds it holds.
+/// Fenwick trees over both find the block of an offset or of a line in
+/// O(log n), and what is left is scanned within that block. An edit only
+/// rescans the text it inserts or the part of a block it erases.
+///
+/// Lines and offsets are counted from 0; a line starts behind each '\n'.
+template<typename GapBuffer>
+struct line_index : GapBuffer::edit_listener {
+  using buffer_type = GapBuffer;
+  using value_type  = typename GapBuffer::value_type;
+  using size_type   = typename GapBuffer::size_type;
+
+  static_assert(simd::is_byte_v<value_type>, "line_index works on byte buffers");
+
+  explicit line_index(GapBuffer& buffer, size_type block_size = 4096)
+      : buffer(buffer), block_size(block_size) {
+    Expects(block_size > 0);
+    reset(buffer);
+    buffer.attach(*this);
+  }
+
+  line_index(const line_index&) = delete;
+  line_index& operator =(const line_index&) = delete;
+
+  ~line_index() override { buffer.detach(*this); }
+
+  size_type line_count() const noexcept { return total_newlines + 1; }
+
+  /// \brief the line holding the element at `offset`
+  size_type offset_to_line(size_type offset) const {
+    Expects(offset <= total_length);
+    size_type k = std::max<size_type>(length_tree.lower_bound(offset), 1) - 1;
+    size_type block_start = length_tree.prefix(k);
+    return newline_tree.prefix(k) + count_newlines(buffer, block_start, offset);
+  }
+
+  /// \brief the offset at which `line` starts
+  size_type line_to_offset(size_type line) const {
+    Expects(line < line_count());
+    if (line == 0) return 0;
+
+    size_type k = newline_tree.lower_bound(line) - 1;
+    size_type remaining = line - newline_tree.prefix(k);
+    size_type block_start = length_tree.prefix(k);
+    const GapBuffer& b = buffer;
+    auto[front, back] = b.segments(b.cbegin() + block_start, b.cbegin() + block_start + lengths[k]);
+
+    size_type skipped = 0;
+    for (auto segment : {front, back}) {
+      const value_type* p = segment.data();
+      const value_type* last = p + segment.size();
+      while ((p = simd::find(p, last, newline)) != last) {
+        ++p;
+        if (--remaining == 0) return block_start + skipped + (p - segment.data());
+      }
+      skipped += segment.size();
+    }
+    Ensures(false);
+    return total_length;
+  }
+
+  void inserted(const GapBuffer& gb, size_type offset, size_type count) override {
+    size_type k = std::max<size_type>(length_tree.lower_bound(offset), 1) - 1;
+    size_type n = count_newlines(gb, offset, offset + count);
+    update(k, count, n);
+    if (lengths[k] > 2 * block_size) split(gb, k);
+  }
+
+  void erasing(const GapBuffer& gb, size_type offset, size_type count) override {
+    size_type k = length_tree.lower_bound(offset + 1) - 1;
+    size_type block_start = length_tree.prefix(k);
+    size_type last = offset + count;
+
+    while (offset < last) {
+      size_type block_end = block_start + lengths[k];
+      size_type part_end = std::min(last, block_end);
+      size_type n = offset == block_start && part_end == block_end
+                    ? newlines[k]
+                    : count_newlines(gb, offset, part_end);
+      update(k, 0 - (part_end - offset), 0 - n);
+
+      offset = part_end;
+      block_start = block_end;
+      ++k;
+    }
+
+    if (lengths.size() > 2 * (total_length / block_size) + 2) compact();
+  }
+
+  void reset(const GapBuffer& gb) override {
+    lengths.clear();
+    newlines.clear();
+    total_length = gb.size();
+    total_newlines = 0;
+    for (size_type first = 0; first < total_length || lengths.empty(); first += block_size) {
+      size_type last = std::min(first + block_size, total_length);
+      lengths.push_back(last - first);
+      newlines.push_back(count_newlines(gb, first, last));
+      total_newlines += newlines.back();
+    }
+    rebuild_trees();
+  }
+
+protected:
+  static constexpr value_type newline = value_type('\n');
+
+  static size_type count_newlines(const GapBuffer& gb, size_type first, size_type last) {
+    return size_type(dr::count(gb.cbegin() + first, gb.cbegin() + last, newline));
+  }
+
+  /// \brief add `length` and `n` (either may be a wrapped negative) to
+  /// block `k`
+  void update(size_type k, size_type length, size_type n) {
+    lengths[k] += length;
+    newlines[k] += n;
+    length_tree.add(k, length);
+    newline_tree.add(k, n);
+    total_length += length;
+    total_newlines += n;
+  }
+
+  /// \brief cut block `k` into pieces of at most block_size elements
+  void split(const GapBuffer& gb, size_type k) {
+    size_type first = length_tree.prefix(k);
+    size_type last = first + lengths[k];
+    size_type pieces = (lengths[k] + block_size - 1) / block_size;
+
+    std::vector<size_type> piece_lengths, piece_newlines;
+    for (size_type i = 0; i < pieces; ++i) {
+      size_type f = first + (last - first) * i / pieces;
+      size_type l = first + (last - first) * (i + 1) / pieces;
+      piece_lengths.push_back(l - f);
+      piece_newlines.push_back(count_newlines(gb, f, l));
+    }
+
+    lengths.erase(lengths.begin() + k);
+    newlines.erase(newlines.begin() + k);
+    lengths.insert(lengths.begin() + k, piece_lengths.begin(), piece_lengths.end());
+    newlines.insert(newlines.begin() + k, piece_newlines.begin(), piece_newlines.end());
+    rebuild_trees();
+  }
+
+  /// \brief merge runs of neighbouring blocks that fit in one block
+  void compact() {
+    size_type out = 0;
+    for (size_type i = 1; i < lengths.size(); ++i) {
+      if (lengths[out] + lengths[i] <= block_size) {
+        lengths[out] += lengths[i];
+        newlines[out] += newlines[i];
+      }
+      else {
+        ++out;
+        lengths[out] = lengths[i];
+        newlines[out] = newlines[i];
+      }
+    }
+    lengths.resize(out + 1);
+    newlines.resize(out + 1);
+    rebuild_trees();
+  }
+
+  void rebuild_trees() {
+    length_tree.assign(lengths);
+    newline_tree.assign(newlines);
+  }
+
+private:
+  GapBuffer& buffer;
+  size_type block_size;
+
+  std::vector<size_type> lengths;   ///< elements per block
+  std::vector<size_type> newlines;  ///< line feeds per block
+  detail::fenwick_tree length_tree;
+  detail::fenwick_tree newline_tree;
+  size_type total_length = 0;
+  size_type total_newlines = 0;
+};
+
+}
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include <gsl/gsl>
+#include "gap_buffer.h"
+
+namespace dr {
+
+/// \brief positions in a gap_buffer which follow its edits
+///
+/// A marker keeps pointing at the same element while text is inserted
+/// and erased around it. Text inserted exactly at a marker goes behind it
+/// for left gravity and in front of it for right gravity; a marker inside
+/// an erased range moves to where the range was.
+///
+/// The markers are kept in position order on two stacks split at the
+/// place of the last edit, much like the elements around the gap. The
+/// markers in front of the split store their offset, those behind it the
+/// distance to the end of the buffer, so an edit at the split changes
+/// neither. Moving the split to the next edit costs a step per marker in
+/// between, an erase a step per marker in the erased range; edits close
+/// to each other are therefore cheap however many markers there are.
+template<typename GapBuffer>
+struct marker_set : GapBuffer::edit_listener {
+  using buffer_type = GapBuffer;
+  using size_type   = typename GapBuffer::size_type;
+
+  /// \brief identifies a marker; stays valid until released
+  using marker = size_type;
+
+  enum class gravity { left, right };
+
+  explicit marker_set(GapBuffer& buffer)
+      : buffer(buffer), length(buffer.size()) {
+    buffer.attach(*this);
+  }
+
+  marker_set(const marker_set&) = delete;
+  marker_set& operator =(const marker_set&) = delete;
+
+  ~marker_set() override { buffer.detach(*this); }
+
+  /// \brief a new marker at `offset`
+  ///
+  /// Like an edit this moves the split, so markers are best created in
+  /// position order.
+  marker create(size_type offset, gravity g = gravity::right) {
+    marker m;
+    if (free_ids.empty()) {
+      m = slots.size();
+      slots.emplace_back();
+    }
+    else {
+      m = free_ids.back();
+      free_ids.pop_back();
+    }
+    slots[m].g = g;
+    slots[m].live = true;
+    place(m, offset);
+    ++live_count;
+    return m;
+  }
+
+  void release(marker m) {
+    Expects(m < slots.size() && slots[m].live);
+    bury(m);
+    slots[m].live = false;
+    free_ids.push_back(m);
+    --live_count;
+  }
+
+  /// \brief put `m` at `offset` as if it had been created there
+  void move(marker m, size_type offset) {
+    Expects(m < slots.size() && slots[m].live);
+    bury(m);
+    place(m, offset);
+  }
+
+  size_type position(marker m) const {
+    Expects(m < slots.size() && slots[m].live);
+    const slot& s = slots[m];
+    return s.behind ? length - behind[s.index].key : in_front[s.index].key;
+  }
+
+  gravity marker_gravity(marker m) const {
+    Expects(m < slots.size() && slots[m].live);
+    return slots[m].g;
+  }
+
+  size_type size() const noexcept { return live_count; }
+
+  void inserted(const GapBuffer&, size_type offset, size_type count) override {
+    // markers behind the split keep their distance to the end and so
+    // move along with the text behind the insertion
+    split_at(offset);
+    length += count;
+  }
+
+  void erasing(const GapBuffer&, size_type offset, size_type count) override {
+    split_at(offset);
+
+    // the markers in [offset, offset + count) end up at `offset`
+    size_type last = offset + count;
+    std::vector<entry>& erased = scratch;
+    erased.clear();
+    while (!behind.empty()) {
+      if (behind.back().id == npos) {
+        behind.pop_back();
+        --tombstones;
+        continue;
+      }
+      if (length - behind.back().key >= last) break;
+      erased.push_back(behind.back());
+      behind.pop_back();
+    }
+
+    // markers at the end of the range with left gravity now sit at the
+    // split and belong in front of it
+    length -= count;
+    split_at(offset);
+    for (const entry& e : erased) push(e.id, offset);
+  }
+
+  /// Markers keep their offsets, cut down to the new size.
+  void reset(const GapBuffer& gb) override {
+    std::vector<std::pair<size_type, marker>> all;
+    for (marker m = 0; m < slots.size(); ++m)
+      if (slots[m].live) all.emplace_back(std::min(position(m), gb.size()), m);
+
+    std::sort(all.begin(), all.end(), [this](const auto& a, const auto& b) {
+      return std::make_pair(a.first, slots[a.second].g) < std::make_pair(b.first, slots[b.second].g);
+    });
+    in_front.clear();
+    behind.clear();
+    tombstones = 0;
+    length = gb.size();
+    for (const auto& p : all) push_in_front(p.second, p.first);
+  }
+
+protected:
+  static constexpr size_type npos = std::numeric_limits<size_type>::max();
+
+  /// \brief a stack element; `id` is npos for a released marker
+  struct entry {
+    size_type key;  ///< offset in front of the split, distance to the end behind it
+    marker id;
+  };
+
+  struct slot {
+    size_type index = 0;  ///< position on its stack
+    bool behind = false;
+    bool live = false;
+    gravity g = gravity::right;
+  };
+
+  /// \brief whether a marker at `pos` with gravity `g` comes after the
+  /// split at `offset`
+  static bool after_split(size_type pos, gravity g, size_type offset) {
+    return pos > offset || (pos == offset && g == gravity::right);
+  }
+
+  /// \brief move markers between the stacks until the split is at `offset`
+  void split_at(size_type offset) {
+    while (!in_front.empty()) {
+      entry e = in_front.back();
+      if (e.id != npos && !after_split(e.key, slots[e.id].g, offset)) break;
+      in_front.pop_back();
+      if (e.id == npos) --tombstones;
+      else push_behind(e.id, e.key);
+    }
+    while (!behind.empty()) {
+      entry e = behind.back();
+      if (e.id != npos && after_split(length - e.key, slots[e.id].g, offset)) break;
+      behind.pop_back();
+      if (e.id == npos) --tombstones;
+      else push_in_front(e.id, length - e.key);
+    }
+  }
+
+  /// \brief push `m` at `offset`, which must be the split
+  void push(marker m, size_type offset) {
+    if (slots[m].g == gravity::left) push_in_front(m, offset);
+    else push_behind(m, offset);
+  }
+
+  void push_in_front(marker m, size_type offset) {
+    slots[m].index = in_front.size();
+    slots[m].behind = false;
+    in_front.push_back({offset, m});
+  }
+
+  void push_behind(marker m, size_type offset) {
+    slots[m].index = behind.size();
+    slots[m].behind = true;
+    behind.push_back({length - offset, m});
+  }
+
+  void place(marker m, size_type offset) {
+    Expects(offset <= length);
+    split_at(offset);
+    push(m, offset);
+  }
+
+  /// \brief leave a tombstone where `m` is stored
+  ///
+  /// Tombstones are dropped as the split passes them, or all at once when
+  /// they outnumber the markers.
+  void bury(marker m) {
+    slot& s = slots[m];
+    (s.behind ? behind : in_front)[s.index].id = npos;
+    if (++tombstones > live_count + 64) drop_tombstones();
+  }
+
+  void drop_tombstones() {
+    for (std::vector<entry>* stack : {&in_front, &behind}) {
+      size_type out = 0;
+      for (const entry& e : *stack) {
+        if (e.id == npos) continue;
+        slots[e.id].index = out;
+        (*stack)[out++] = e;
+      }
+      stack->resize(out);
+    }
+    tombstones = 0;
+  }
+
+private:
+  GapBuffer& buffer;
+  size_type length;  ///< size of the buffer as far as the markers know
+
+  std::vector<entry> in_front;  ///< ascending, nearest to the split last
+  std::vector<entry> behind;    ///< descending positions, nearest to the split last
+  std::vector<slot> slots;      ///< indexed by marker
+  std::vector<marker> free_ids;
+  std::vector<entry> scratch;
+  size_type live_count = 0;
+  size_type tombstones = 0;
+};
+
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace dr {
+
+/// \brief allocator which maps anonymous memory directly from the kernel
+///
+/// Every allocation is a private page-aligned mapping. Besides the standard
+/// allocator interface it offers two extensions that gap_buffer picks up
+/// for trivially copyable elements:
+///  - `reallocate(p, old_n, new_n)` grows a mapping with mremap, so the
+///    kernel moves page table entries instead of the contents being copied;
+///  - `discard(p, n)` gives the whole pages inside [p, p + n) back to the
+///    OS; they read as zero when touched again.
+///
+/// Capacities are best chosen as whole pages, e.g. with page_growth_policy.
+///
+/// \tparam HugePages  advise the kernel to back large mappings with
+///                    transparent huge pages
+template<typename T, bool HugePages = false>
+struct mmap_allocator {
+  using value_type = T;
+  using is_always_equal = std::true_type;
+
+  template<typename U>
+  struct rebind { using other = mmap_allocator<U, HugePages>; };
+
+  /// discarding fewer bytes than this is not worth a system call
+  static constexpr std::size_t discard_threshold = std::size_t(1) << 20;
+
+  mmap_allocator() = default;
+
+  template<typename U>
+  mmap_allocator(const mmap_allocator<U, HugePages>&) noexcept { }
+
+  T* allocate(std::size_t n) {
+    std::size_t bytes = mapping_size(n);
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) throw std::bad_alloc();
+    advise(p, bytes);
+    return static_cast<T*>(p);
+  }
+
+  void deallocate(T* p, std::size_t n) noexcept {
+    munmap(p, mapping_size(n));
+  }
+
+  /// \brief resize the mapping at `p` to hold `new_n` elements, keeping
+  /// the first min(old_n, new_n) of them
+  /// \return the possibly moved mapping
+  T* reallocate(T* p, std::size_t old_n, std::size_t new_n) {
+    std::size_t old_bytes = mapping_size(old_n);
+    std::size_t new_bytes = mapping_size(new_n);
+    if (old_bytes == new_bytes) return p;
+
+#ifdef __linux__
+    void* q = mremap(p, old_bytes, new_bytes, MREMAP_MAYMOVE);
+    if (q == MAP_FAILED) throw std::bad_alloc();
+    advise(q, new_bytes);
+    return static_cast<T*>(q);
+#else
+    T* q = allocate(new_n);
+    std::memcpy(q, p, std::min(old_bytes, new_bytes));
+    deallocate(p, old_n);
+    return q;
+#endif
+  }
+
+  /// \brief release the pages lying wholly inside [p, p + n)
+  void discard(T* p, std::size_t n) noexcept {
+    auto page = page_size();
+    auto first = (reinterpret_cast<std::uintptr_t>(p) + page - 1) / page * page;
+    auto last = reinterpret_cast<std::uintptr_t>(p + n) / page * page;
+    if (last > first && last - first >= discard_threshold)
+      madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED);
+  }
+
+  static std::size_t page_size() noexcept {
+    static const std::size_t size = std::size_t(sysconf(_SC_PAGESIZE));
+    return size;
+  }
+
+  friend bool operator ==(const mmap_allocator&, const mmap_allocator&) noexcept { return true; }
+  friend bool operator !=(const mmap_allocator&, const mmap_allocator&) noexcept { return false; }
+
+private:
+  static std::size_t mapping_size(std::size_t n) noexcept {
+    auto page = page_size();
+    return std::max<std::size_t>(1, (n * sizeof(T) + page - 1) / page) * page;
+  }
+
+  static void advise(void* p, std::size_t bytes) noexcept {
+#ifdef MADV_HUGEPAGE
+    if (HugePages && bytes >= (std::size_t(2) << 20)) madvise(p, bytes, MADV_HUGEPAGE);
+#else
+    (void) p;
+    (void) bytes;
+#endif
+  }
+};
+
+}
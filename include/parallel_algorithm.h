@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include "gap_buffer.h"
+#include "segmented_algorithm.h"
+#include "thread_pool.h"
+
+namespace dr {
+
+/// \brief the segmented algorithms spread over a thread_pool
+///
+/// A range is cut into chunks of `chunk_bytes` at fixed offsets from its
+/// start; a chunk holding the gap is handled as its two spans. Ranges of
+/// a single chunk run on the calling thread.
+namespace parallel {
+
+/// \brief bytes per chunk, small enough to stay in a core's L2 cache
+constexpr std::size_t chunk_bytes = std::size_t(256) << 10;
+
+namespace detail {
+
+template<typename It>
+constexpr std::size_t chunk_length =
+    std::max<std::size_t>(1, chunk_bytes / sizeof(typename std::iterator_traits<It>::value_type));
+
+/// \brief call `f(offset, spans)` for every chunk of [first, last), with
+/// `offset` the chunk's distance from `first`
+template<typename SegIt, typename F>
+void for_each_chunk(SegIt first, SegIt last, thread_pool& pool, F f) {
+  std::size_t n = std::size_t(last - first);
+  std::size_t c = chunk_length<SegIt>;
+  pool.parallel_for((n + c - 1) / c, [&](std::size_t k) {
+    std::size_t offset = k * c;
+    auto chunk_first = first + std::ptrdiff_t(offset);
+    f(offset, segments(chunk_first, chunk_first + std::ptrdiff_t(std::min(c, n - offset))));
+  });
+}
+
+inline std::uint64_t mix(std::uint64_t h, std::uint64_t v) noexcept {
+  h = (h ^ v) * 0x9e3779b97f4a7c15ull;
+  return h ^ (h >> 29);
+}
+
+/// \brief hash of a sequence fed in pieces; the pieces do not matter,
+/// only the elements
+template<typename V>
+struct stream_hasher {
+  void update(const V* p, std::size_t n) {
+    length += n;
+    if constexpr (simd::is_byte_v<V>) {
+      auto bytes = reinterpret_cast<const unsigned char*>(p);
+      while (n > 0 && pending_size > 0 && pending_size < 8) {
+        pending |= std::uint64_t(*bytes++) << (8 * pending_size++);
+        --n;
+      }
+      if (pending_size == 8) {
+        h = mix(h, pending);
+        pending = 0;
+        pending_size = 0;
+      }
+      for (; n >= 8; n -= 8, bytes += 8) {
+        std::uint64_t word;
+        std::memcpy(&word, bytes, 8);
+        h = mix(h, word);
+      }
+      for (; n > 0; --n) pending |= std::uint64_t(*bytes++) << (8 * pending_size++);
+    }
+    else {
+      for (std::size_t i = 0; i < n; ++i) h = mix(h, std::hash<V>{}(p[i]));
+    }
+  }
+
+  std::uint64_t finish() const noexcept { return mix(mix(h, pending), length); }
+
+  std::uint64_t h = 0xcbf29ce484222325ull;
+  std::uint64_t pending = 0;
+  unsigned pending_size = 0;
+  std::uint64_t length = 0;
+};
+
+}
+
+template<typename SegIt, typename T,
+         std::enable_if_t<is_segmented_iterator_v<SegIt>, int> = 0>
+typename std::iterator_traits<SegIt>::difference_type
+count(SegIt first, SegIt last, const T& value, thread_pool& pool = thread_pool::shared()) {
+  std::atomic<typename std::iterator_traits<SegIt>::difference_type> total{0};
+  detail::for_each_chunk(first, last, pool, [&](std::size_t, auto spans) {
+    auto[front, back] = spans;
+    total += dr::detail::segment_count(front.data(), dr::detail::span_end(front), value)
+             + dr::detail::segment_count(back.data(), dr::detail::span_end(back), value);
+  });
+  return total;
+}
+
+template<typename SegIt, typename UnaryPredicate,
+         std::enable_if_t<is_segmented_iterator_v<SegIt>, int> = 0>
+typename std::iterator_traits<SegIt>::difference_type
+count_if(SegIt first, SegIt last, UnaryPredicate p, thread_pool& pool = thread_pool::shared()) {
+  std::atomic<typename std::iterator_traits<SegIt>::difference_type> total{0};
+  detail::for_each_chunk(first, last, pool, [&](std::size_t, auto spans) {
+    auto[front, back] = spans;
+    total += std::count_if(front.data(), dr::detail::span_end(front), p)
+             + std::count_if(back.data(), dr::detail::span_end(back), p);
+  });
+  return total;
+}
+
+/// \brief std::transform into a random access or segmented iterator,
+/// which may be `first` itself
+template<typename SegIt, typename OutputIt, typename UnaryOperation,
+         std::enable_if_t<is_segmented_iterator_v<SegIt>, int> = 0>
+OutputIt transform(SegIt first, SegIt last, OutputIt d_first, UnaryOperation op,
+                   thread_pool& pool = thread_pool::shared()) {
+  detail::for_each_chunk(first, last, pool, [&](std::size_t offset, auto spans) {
+    auto out = d_first + std::ptrdiff_t(offset);
+    if constexpr (is_segmented_iterator_v<OutputIt>) {
+      auto length = spans.first.size() + spans.second.size();
+      dr::detail::zip_segments(spans, segments(out, out + length), [&](auto p, auto q, std::size_t n) {
+        std::transform(p, p + n, q, op);
+        return n;
+      });
+    }
+    else {
+      out = std::transform(spans.first.data(), dr::detail::span_end(spans.first), out, op);
+      std::transform(spans.second.data(), dr::detail::span_end(spans.second), out, op);
+    }
+  });
+  return d_first + (last - first);
+}
+
+/// \brief std::copy into a random access or segmented iterator
+template<typename SegIt, typename OutputIt,
+         std::enable_if_t<is_segmented_iterator_v<SegIt>, int> = 0>
+OutputIt copy(SegIt first, SegIt last, OutputIt d_first, thread_pool& pool = thread_pool::shared()) {
+  detail::for_each_chunk(first, last, pool, [&](std::size_t offset, auto spans) {
+    auto out = d_first + std::ptrdiff_t(offset);
+    if constexpr (is_segmented_iterator_v<OutputIt>) {
+      auto length = spans.first.size() + spans.second.size();
+      dr::detail::zip_segments(spans, segments(out, out + length), [](auto p, auto q, std::size_t n) {
+        std::copy(p, p + n, q);
+        return n;
+      });
+    }
+    else {
+      out = std::copy(spans.first.data(), dr::detail::span_end(spans.first), out);
+      std::copy(spans.second.data(), dr::detail::span_end(spans.second), out);
+    }
+  });
+  return d_first + (last - first);
+}
+
+template<typename SegIt1, typename SegIt2,
+         std::enable_if_t<is_segmented_iterator_v<SegIt1> && is_segmented_iterator_v<SegIt2>, int> = 0>
+bool equal(SegIt1 first1, SegIt1 last1, SegIt2 first2, SegIt2 last2,
+           thread_pool& pool = thread_pool::shared()) {
+  if (last1 - first1 != last2 - first2) return false;
+
+  std::atomic<bool> differ{false};
+  detail::for_each_chunk(first1, last1, pool, [&](std::size_t offset, auto spans) {
+    if (differ.load(std::memory_order_relaxed)) return;
+
+    auto length = spans.first.size() + spans.second.size();
+    auto other = first2 + std::ptrdiff_t(offset);
+    auto done = dr::detail::zip_segments(spans, segments(other, other + length), [](auto p, auto q, std::size_t n) {
+      return std::equal(p, p + n, q) ? n : std::size_t(0);
+    });
+    if (std::size_t(done) != length) differ.store(true, std::memory_order_relaxed);
+  });
+  return !differ;
+}
+
+/// \brief a 64-bit hash of the elements of [first, last)
+///
+/// The value depends on the elements alone, not on where the gap is, so
+/// equal ranges hash equal. Bytes are hashed eight at a time, other
+/// elements through std::hash.
+template<typename SegIt,
+         std::enable_if_t<is_segmented_iterator_v<SegIt>, int> = 0>
+std::uint64_t hash(SegIt first, SegIt last, thread_pool& pool = thread_pool::shared()) {
+  using V = typename std::iterator_traits<SegIt>::value_type;
+  std::size_t c = detail::chunk_length<SegIt>;
+  std::vector<std::uint64_t> hashes((std::size_t(last - first) + c - 1) / c);
+  detail::for_each_chunk(first, last, pool, [&](std::size_t offset, auto spans) {
+    detail::stream_hasher<V> h;
+    h.update(spans.first.data(), spans.first.size());
+    h.update(spans.second.data(), spans.second.size());
+    hashes[offset / c] = h.finish();
+  });
+
+  std::uint64_t h = detail::mix(0, hashes.size());
+  for (std::uint64_t chunk : hashes) h = detail::mix(h, chunk);
+  return h;
+}
+
+template<typename T, typename Allocator, typename GrowthPolicy, std::size_t InlineCapacity>
+bool equal(const gap_buffer<T, Allocator, GrowthPolicy, InlineCapacity>& lhs,
+           const gap_buffer<T, Allocator, GrowthPolicy, InlineCapacity>& rhs,
+           thread_pool& pool = thread_pool::shared()) {
+  return parallel::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), pool);
+}
+
+/// \brief gap_buffer::substr with the elements copied in parallel
+template<typename T, typename Allocator, typename GrowthPolicy, std::size_t InlineCapacity>
+gap_buffer<T, Allocator, GrowthPolicy, InlineCapacity>
+substr(const gap_buffer<T, Allocator, GrowthPolicy, InlineCapacity>& gb,
+       typename gap_buffer<T, Allocator, GrowthPolicy, InlineCapacity>::const_iterator first,
+       typename gap_buffer<T, Allocator, GrowthPolicy, InlineCapacity>::const_iterator last,
+       thread_pool& pool = thread_pool::shared()) {
+  if constexpr (std::is_trivially_copyable_v<T>) {
+    auto n = std::size_t(last - first);
+    gap_buffer<T, Allocator, GrowthPolicy, InlineCapacity> out(
+        n, std::allocator_traits<Allocator>::select_on_container_copy_construction(gb.get_allocator()));
+    auto gap = out.prepare(out.cbegin(), n);
+    parallel::copy(first, last, gap.data(), pool);
+    out.commit(n);
+    return out;
+  }
+  else
+    return gb.substr(first, last);
+}
+
+}
+
+}
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "simd_kernels.h"
+
+namespace dr {
+
+/// \brief whether `It` is a segmented iterator
+///
+/// A segmented iterator provides, via ADL, a `segments(first, last)` which
+/// returns the range [first, last) as a pair of contiguous spans. The
+/// algorithms below run the standard algorithms over the raw memory of
+/// each span instead of stepping the iterator element by element.
+template<typename It, typename = void>
+struct is_segmented_iterator : std::false_type { };
+
+template<typename It>
+struct is_segmented_iterator<It, std::void_t<decltype(segments(std::declval<It>(), std::declval<It>()))>>
+    : std::true_type { };
+
+template<typename It>
+constexpr bool is_segmented_iterator_v = is_segmented_iterator<It>::value;
+
+namespace detail {
+
+template<typename Span>
+auto span_end(const Span& s) { return s.data() + s.size(); }
+
+/// \brief walk two span pairs of equal total length in lockstep
+///
+/// `f(p, q, n)` is called on aligned chunks and returns how many leading
+/// elements it accepted; the walk stops at the first chunk it does not
+/// accept completely.
+/// \return the number of elements accepted
+template<typename SpanPair1, typename SpanPair2, typename F>
+std::ptrdiff_t zip_segments(const SpanPair1& a, const SpanPair2& b, F f) {
+  using ptr1 = decltype(a.first.data());
+  using ptr2 = decltype(b.first.data());
+  std::pair<ptr1, std::size_t> as[2] = {{a.first.data(), a.first.size()}, {a.second.data(), a.second.size()}};
+  std::pair<ptr2, std::size_t> bs[2] = {{b.first.data(), b.first.size()}, {b.second.data(), b.second.size()}};
+
+  std::ptrdiff_t done = 0;
+  for (int i = 0, j = 0; i < 2 && j < 2;) {
+    if (as[i].second == 0) { ++i; continue; }
+    if (bs[j].second == 0) { ++j; continue; }
+
+    std::size_t n = std::min(as[i].second, bs[j].second);
+    std::size_t accepted = f(as[i].first, bs[j].first, n);
+    done += accepted;
+    if (accepted < n) break;
+
+    as[i].first += n;
+    as[i].second -= n;
+    bs[j].first += n;
+    bs[j].second -= n;
+  }
+  return done;
+}
+
+/// \brief whether `value` can be looked for in elements of type `V` with
+/// the byte kernels
+template<typename V, typename T>
+constexpr bool byte_search_v = simd::is_byte_v<V> && (std::is_same_v<T, V> || std::is_arithmetic_v<T>);
+
+/// \brief std::find over one segment, vectorized for bytes
+template<typename V, typename T>
+const V* segment_find(const V* first, const V* last, const T& value) {
+  if constexpr (byte_search_v<V, T>) {
+    // a value no V converts back to cannot compare equal to any element
+    V v = static_cast<V>(value);
+    if (!(v == value)) return last;
+    return simd::find(first, last, v);
+  }
+  else
+    return std::find(first, last, value);
+}
+
+template<typename V, typename T>
+std::ptrdiff_t segment_count(const V* first, const V* last, const T& value) {
+  if constexpr (byte_search_v<V, T>) {
+    V v = static_cast<V>(value);
+    if (!(v == value)) return 0;
+    return std::ptrdiff_t(simd::count(first, last, v));
+  }
+  else
+    return std::count(first, last, value);
+}
+
+/// \brief std::mismatch over one pair of chunks
+///
+/// Bytes are compared 64 at a time with memcmp, which compiles to a few
+/// vector compares, before std::mismatch finds the differing one.
+template<typename P, typename Q>
+std::size_t segment_mismatch(P p, Q q, std::size_t n) {
+  using V1 = std::remove_cv_t<std::remove_pointer_t<P>>;
+  using V2 = std::remove_cv_t<std::remove_pointer_t<Q>>;
+  std::size_t i = 0;
+  if constexpr (simd::is_byte_v<V1> && std::is_same_v<V1, V2>)
+    for (; i + 64 <= n; i += 64)
+      if (std::memcmp(p + i, q + i, 64) != 0) break;
+  return std::size_t(std::mismatch(p + i, p + n, q + i).first - p);
+}
+
+template<typename V>
+const V* segment_search(const V* first, const V* last, const V* s_first, const V* s_last) {
+  if constexpr (simd::is_byte_v<V>)
+    return simd::search(first, last, s_first, s_last);
+  else
+    return std::search(first, last, s_first, s_last);
+}
+
+/// \brief the first occurrence of needle [s, s + m) in the concatenation of
+/// [a, a + na) and [b, b + nb), including the ones that straddle the two
+/// \return its offset, or na + nb
+template<typename V>
+std::size_t search_segments(const V* a, std::size_t na, const V* b, std::size_t nb,
+                            const V* s, std::size_t m) {
+  if (m == 0) return 0;
+
+  const V* hit = segment_search(a, a + na, s, s + m);
+  if (hit != a + na) return hit - a;
+
+  // starts within the last m - 1 elements of a, ending in b
+  std::size_t from = na >= m ? na - m + 1 : 0;
+  for (std::size_t i = segment_find(a + from, a + na, s[0]) - a; i < na; ++i) {
+    std::size_t in_a = na - i;
+    if (m - in_a > nb) break;
+    if (std::equal(a + i, a + na, s) && std::equal(b, b + (m - in_a), s + in_a)) return i;
+  }
+
+  hit = segment_search(b, b + nb, s, s + m);
+  return hit != b + nb ? na + (hit - b) : na + nb;
+}
+
+}
+
+template<typename SegIt, typename OutputIt,
+         std::enable_if_t<is_segmented_iterator_v<SegIt>, int> = 0>
+OutputIt copy(SegIt first, SegIt last, OutputIt d_first) {
+  auto[front, back] = segments(first, last);
+  d_first = std::copy(front.data(), detail::span_end(front), d_first);
+  return std::copy(back.data(), detail::span_end(back), d_first);
+}
+
+template<typename SegIt, typename T,
+         std::enable_if_t<is_segmented_iterator_v<SegIt>, int> = 0>
+SegIt find(SegIt first, SegIt last, const T& value) {
+  auto[front, back] = segments(first, last);
+  auto it = detail::segment_find(front.data(), detail::span_end(front), value);
+  if (it != detail::span_end(front)) return first + (it - front.data());
+
+  it = detail::segment_find(back.data(), detail::span_end(back), value);
+  return first + (std::ptrdiff_t(front.size()) + (it - back.data()));
+}
+
+/// \brief the first element equal to any of [s_first, s_last)
+///
+/// Byte sequences are searched with the vector kernels for small sets.
+template<typename SegIt, typename ForwardIt,
+         std::enable_if_t<is_segmented_iterator_v<SegIt>, int> = 0>
+SegIt find_first_of(SegIt first, SegIt last, ForwardIt s_first, ForwardIt s_last) {
+  using V = typename std::iterator_traits<SegIt>::value_type;
+  auto[front, back] = segments(first, last);
+
+  if constexpr (simd::is_byte_v<V> && simd::is_byte_v<typename std::iterator_traits<ForwardIt>::value_type>) {
+    // every distinct byte of the set, at most 256 of them
+    V set[256];
+    bool seen[256] = {};
+    std::size_t set_size = 0;
+    for (; s_first != s_last; ++s_first) {
+      auto b = static_cast<unsigned char>(*s_first);
+      if (!seen[b]) {
+        seen[b] = true;
+        set[set_size++] = static_cast<V>(b);
+      }
+    }
+
+    auto it = simd::find_first_of(front.data(), detail::span_end(front), set, set + set_size);
+    if (it != detail::span_end(front)) return first + (it - front.data());
+    it = simd::find_first_of(back.data(), detail::span_end(back), set, set + set_size);
+    return first + (std::ptrdiff_t(front.size()) + (it - back.data()));
+  }
+  else {
+    auto it = std::find_first_of(front.data(), detail::span_end(front), s_first, s_last);
+    if (it != detail::span_end(front)) return first + (it - front.data());
+    it = std::find_first_of(back.data(), detail::span_end(back), s_first, s_last);
+    return first + (std::ptrdiff_t(front.size()) + (it - back.data()));
+  }
+}
+
+/// \brief the first occurrence of [s_first, s_last), which may straddle the
+/// boundary between the two segments
+template<typename SegIt, typename ForwardIt,
+         std::enable_if_t<is_segmented_iterator_v<SegIt>, int> = 0>
+SegIt search(SegIt first, SegIt last, ForwardIt s_first, ForwardIt s_last) {
+  using V = typename std::iterator_traits<SegIt>::value_type;
+  auto[front, back] = segments(first, last);
+
+  auto run = [&](const V* s, std::size_t m) {
+    return first + std::ptrdiff_t(detail::search_segments<V>(front.data(), front.size(),
+                                                             back.data(), back.size(), s, m));
+  };
+  if constexpr (std::is_convertible_v<ForwardIt, const V*>)
+    return run(s_first, s_last - s_first);
+  else {
+    std::vector<V> needle(s_first, s_last);
+    return run(needle.data(), needle.size());
+  }
+}
+
+template<typename SegIt, typename T,
+         std::enable_if_t<is_segmented_iterator_v<SegIt>, int> = 0>
+typename std::iterator_traits<SegIt>::difference_type
+count(SegIt first, SegIt last, const T& value) {
+  auto[front, back] = segments(first, last);
+  return detail::segment_count(front.data(), detail::span_end(front), value)
+         + detail::segment_count(back.data(), detail::span_end(back), value);
+}
+
+template<typename SegIt, typename UnaryFunction,
+         std::enable_if_t<is_segmented_iterator_v<SegIt>, int> = 0>
+UnaryFunction for_each(SegIt first, SegIt last, UnaryFunction f) {
+  auto[front, back] = segments(first, last);
+  return std::for_each(back.data(), detail::span_end(back),
+                       std::for_each(front.data(), detail::span_end(front), std::move(f)));
+}
+
+template<typename SegIt1, typename SegIt2,
+         std::enable_if_t<is_segmented_iterator_v<SegIt1> && is_segmented_iterator_v<SegIt2>, int> = 0>
+std::pair<SegIt1, SegIt2> mismatch(SegIt1 first1, SegIt1 last1, SegIt2 first2, SegIt2 last2) {
+  auto n = std::min<std::ptrdiff_t>(last1 - first1, last2 - first2);
+  auto done = detail::zip_segments(
+      segments(first1, first1 + n), segments(first2, first2 + n),
+      [](auto p, auto q, std::size_t len) { return detail::segment_mismatch(p, q, len); });
+  return {first1 + done, first2 + done};
+}
+
+template<typename SegIt1, typename SegIt2,
+         std::enable_if_t<is_segmented_iterator_v<SegIt1> && is_segmented_iterator_v<SegIt2>, int> = 0>
+bool equal(SegIt1 first1, SegIt1 last1, SegIt2 first2, SegIt2 last2) {
+  auto n = last1 - first1;
+  if (n != last2 - first2) return false;
+  auto done = detail::zip_segments(
+      segments(first1, last1), segments(first2, last2),
+      [](auto p, auto q, std::size_t len) {
+        return std::equal(p, p + len, q) ? len : std::size_t(0);
+      });
+  return done == n;
+}
+
+}
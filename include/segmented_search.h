@@ -0,0 +1,294 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "segmented_algorithm.h"
+#include "simd_kernels.h"
+
+namespace dr {
+
+/// \brief search for one pattern over segmented iterators
+///
+/// The pattern is preprocessed once; each search then scans the two
+/// segments of the range in place, matches straddling the gap included.
+/// Like std::boyer_moore_horspool_searcher it is called with a range and
+/// returns the [begin, end) of the first match, or [last, last):
+///
+///     dr::pattern_searcher<char> s(word.begin(), word.end());
+///     for (auto m = s(gb.begin(), gb.end()); m.first != gb.end(); m = s(m.second, gb.end()))
+///       ...
+///
+/// Offsets survive edits where iterators do not; a replace-all loop
+/// resumes with `s(gb.begin() + offset, gb.end())`.
+///
+/// Elements are skipped Boyer-Moore-Horspool style, through a hash map
+/// built from the pattern. Bytes compared with std::equal_to go to the
+/// vector search kernel instead, which tests 16 or 32 positions at a
+/// time and so outruns Horspool's chain of dependent loads for all but
+/// very long patterns, see bench/search_bench.cc.
+template<typename V, typename Hash = std::hash<V>, typename BinaryPredicate = std::equal_to<V>>
+struct pattern_searcher {
+  static constexpr std::size_t npos = std::size_t(-1);
+
+  template<typename ForwardIt>
+  pattern_searcher(ForwardIt first, ForwardIt last, Hash hf = Hash(), BinaryPredicate pred = BinaryPredicate())
+      : pattern(first, last), skip_map(0, std::move(hf), pred), pred(pred) {
+    if constexpr (!vector_kernel) {
+      std::size_t m = pattern.size();
+      for (std::size_t i = 0; i + 1 < m; ++i) skip_map[pattern[i]] = m - 1 - i;
+    }
+  }
+
+  std::size_t size() const noexcept { return pattern.size(); }
+
+  /// \return the first match in [first, last)
+  template<typename SegIt,
+           std::enable_if_t<is_segmented_iterator_v<SegIt>, int> = 0>
+  std::pair<SegIt, SegIt> operator ()(SegIt first, SegIt last) const {
+    auto[front, back] = segments(first, last);
+    std::size_t offset = find(front.data(), front.size(), back.data(), back.size());
+    if (offset == npos) return {last, last};
+    auto match = first + std::ptrdiff_t(offset);
+    return {match, match + std::ptrdiff_t(pattern.size())};
+  }
+
+  /// \brief the first match in the concatenation of [a, a + na) and
+  /// [b, b + nb)
+  /// \return its offset, or npos
+  std::size_t find(const V* a, std::size_t na, const V* b, std::size_t nb) const {
+    std::size_t m = pattern.size();
+    if (m == 0) return 0;
+
+    std::size_t hit = scan(a, na, 0);
+    if (hit != npos) return hit;
+
+    if (na > 0 && nb > 0 && m > 1) {
+      // the windows starting in the last m - 1 elements of a, ending in b
+      std::size_t from = na >= m - 1 ? na - (m - 1) : 0;
+      std::vector<V> window(a + from, a + na);
+      window.insert(window.end(), b, b + std::min(nb, m - 1));
+      hit = scan(window.data(), window.size(), 0);
+      if (hit != npos) return from + hit;
+    }
+
+    hit = scan(b, nb, 0);
+    return hit != npos ? na + hit : npos;
+  }
+
+protected:
+  static constexpr bool vector_kernel =
+      simd::is_byte_v<V> && std::is_same_v<BinaryPredicate, std::equal_to<V>>;
+
+  std::size_t skip(const V& v) const {
+    auto it = skip_map.find(v);
+    return it != skip_map.end() ? it->second : pattern.size();
+  }
+
+  /// \brief the first window of [t, t + n) at or after `pos` matching the
+  /// pattern
+  std::size_t scan(const V* t, std::size_t n, std::size_t pos) const {
+    std::size_t m = pattern.size();
+    if constexpr (vector_kernel) {
+      if (pos + m > n) return npos;
+      const V* hit = simd::search(t + pos, t + n, pattern.data(), pattern.data() + m);
+      return hit != t + n ? std::size_t(hit - t) : npos;
+    }
+    else {
+      // compared back to front, last element first
+      std::size_t last = m - 1;
+      while (pos + m <= n) {
+        const V& c = t[pos + last];
+        if (pred(c, pattern[last]) && std::equal(pattern.begin(), pattern.end() - 1, t + pos, pred))
+          return pos;
+        pos += skip(c);
+      }
+      return npos;
+    }
+  }
+
+private:
+  std::vector<V> pattern;
+  std::unordered_map<V, std::size_t, Hash, BinaryPredicate> skip_map;
+  BinaryPredicate pred;
+};
+
+template<typename ForwardIt>
+pattern_searcher(ForwardIt, ForwardIt) -> pattern_searcher<typename std::iterator_traits<ForwardIt>::value_type>;
+
+/// \brief Aho-Corasick search for a set of keywords over segmented
+/// iterators of bytes
+///
+/// The keywords are compiled once into an automaton with a full
+/// transition table, so each element of the text costs one table lookup
+/// however many keywords there are. The automaton runs over the front
+/// segment and then straight on over the back one, which finds matches
+/// across the gap without special cases.
+template<typename V>
+struct keyword_searcher {
+  static_assert(simd::is_byte_v<V>, "keyword_searcher needs a byte value_type");
+
+  /// \brief one occurrence of a keyword
+  struct match {
+    std::size_t offset;   ///< from the start of the searched range
+    std::size_t length;
+    std::size_t keyword;  ///< index of the keyword in the set
+  };
+
+  template<typename ForwardRange>
+  explicit keyword_searcher(const ForwardRange& keywords) {
+    build(std::begin(keywords), std::end(keywords));
+  }
+
+  keyword_searcher(std::initializer_list<std::basic_string_view<V>> keywords) {
+    build(keywords.begin(), keywords.end());
+  }
+
+  std::size_t keyword_count() const noexcept { return lengths.size(); }
+
+  /// \brief call `f(match)` for every occurrence in [first, last), in
+  /// order of their end and longest first for the same end, overlapping
+  /// ones included; `f` returns false to stop
+  /// \return whether the whole range was scanned
+  template<typename SegIt, typename F,
+           std::enable_if_t<is_segmented_iterator_v<SegIt>, int> = 0>
+  bool for_each_match(SegIt first, SegIt last, F f) const {
+    auto[front, back] = segments(first, last);
+    std::uint32_t state = 0;
+    return scan(front.data(), front.size(), 0, state, f)
+           && scan(back.data(), back.size(), front.size(), state, f);
+  }
+
+  /// \return the first match in [first, last), the one ending first and
+  /// the longest of those, or [last, last)
+  ///
+  /// Resuming at the end of each match visits non-overlapping matches,
+  /// which is what a replace-all loop wants.
+  template<typename SegIt,
+           std::enable_if_t<is_segmented_iterator_v<SegIt>, int> = 0>
+  std::pair<SegIt, SegIt> operator ()(SegIt first, SegIt last) const {
+    std::pair<SegIt, SegIt> result(last, last);
+    for_each_match(first, last, [&](const match& m) {
+      result.first = first + std::ptrdiff_t(m.offset);
+      result.second = result.first + std::ptrdiff_t(m.length);
+      return false;
+    });
+    return result;
+  }
+
+protected:
+  static constexpr std::uint32_t none = std::uint32_t(-1);
+
+  std::uint32_t& next(std::uint32_t state, unsigned char c) { return transitions[state * 256 + c]; }
+
+  std::uint32_t add_state() {
+    transitions.insert(transitions.end(), 256, none);
+    keyword.push_back(none);
+    report.push_back(none);
+    return std::uint32_t(keyword.size() - 1);
+  }
+
+  template<typename It>
+  void build(It first, It last) {
+    add_state();
+    for (; first != last; ++first) {
+      std::uint32_t state = 0;
+      std::size_t length = 0;
+      for (auto c : *first) {
+        auto b = static_cast<unsigned char>(c);
+        if (next(state, b) == none) {
+          std::uint32_t s = add_state();
+          next(state, b) = s;
+        }
+        state = next(state, b);
+        ++length;
+      }
+      // an empty or repeated keyword never shows up as a match of its own
+      if (length > 0 && keyword[state] == none) keyword[state] = std::uint32_t(lengths.size());
+      lengths.push_back(length);
+    }
+
+    // breadth first, so that the failure state of each state is complete
+    // before its children fill their missing transitions from it
+    std::vector<std::uint32_t> fail(keyword.size(), 0);
+    std::vector<std::uint32_t> queue;
+    for (unsigned c = 0; c < 256; ++c) {
+      std::uint32_t s = next(0, (unsigned char) c);
+      if (s == none)
+        next(0, (unsigned char) c) = 0;
+      else {
+        queue.push_back(s);
+        starts.push_back(static_cast<V>(c));
+      }
+    }
+    for (std::size_t i = 0; i < queue.size(); ++i) {
+      std::uint32_t state = queue[i];
+      std::uint32_t f = fail[state];
+      // the longest keyword ending here is this state's own, then those of
+      // its failure chain
+      report[state] = keyword[state] != none ? state : report[f];
+      for (unsigned c = 0; c < 256; ++c) {
+        std::uint32_t s = next(state, (unsigned char) c);
+        if (s == none)
+          next(state, (unsigned char) c) = next(f, (unsigned char) c);
+        else {
+          fail[s] = next(f, (unsigned char) c);
+          queue.push_back(s);
+        }
+      }
+    }
+
+    // the output chain: from a state reporting a keyword to the next
+    // shorter keyword ending at the same place
+    suffix_report.assign(keyword.size(), none);
+    for (std::uint32_t state : queue)
+      if (report[state] == state) suffix_report[state] = report[fail[state]];
+  }
+
+  /// Back in the start state, the text up to the next byte which can
+  /// begin a keyword is skipped with the vector kernels if there are few
+  /// such bytes.
+  template<typename F>
+  bool scan(const V* p, std::size_t n, std::size_t base, std::uint32_t& state, F& f) const {
+    bool skip_to_starts = !starts.empty() && starts.size() <= simd::detail::max_vector_set;
+    for (std::size_t i = 0; i < n; ++i) {
+      if (state == 0 && skip_to_starts) {
+        i = std::size_t(simd::find_first_of(p + i, p + n, starts.data(), starts.data() + starts.size()) - p);
+        if (i == n) break;
+      }
+      state = transitions[state * 256 + static_cast<unsigned char>(p[i])];
+      for (std::uint32_t s = report[state]; s != none; s = suffix_report[s]) {
+        std::size_t length = lengths[keyword[s]];
+        if (!f(match{base + i + 1 - length, length, keyword[s]})) return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  std::vector<std::uint32_t> transitions;    ///< 256 per state
+  std::vector<std::uint32_t> keyword;        ///< keyword ending in a state, or none
+  std::vector<std::uint32_t> report;         ///< first state on the failure chain with a keyword
+  std::vector<std::uint32_t> suffix_report;  ///< the one after that
+  std::vector<std::size_t> lengths;          ///< of each keyword
+  std::vector<V> starts;                     ///< bytes leaving the start state
+};
+
+/// \brief the first match of `searcher` in [first, last), like std::search
+/// with a searcher
+template<typename SegIt, typename Searcher,
+         std::enable_if_t<is_segmented_iterator_v<SegIt>, int> = 0>
+SegIt search(SegIt first, SegIt last, const Searcher& searcher) {
+  return searcher(first, last).first;
+}
+
+}
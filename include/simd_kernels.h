@@ -0,0 +1,318 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define DR_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace dr {
+namespace simd {
+
+/// \brief search and count kernels over contiguous bytes
+///
+/// Each kernel comes in a scalar, an SSE2 and an AVX2 version; the best one
+/// the CPU supports is picked at run time. The segmented algorithms use
+/// them for gap_buffer<char> and friends.
+
+using byte = unsigned char;
+
+/// \brief whether elements of type `B` can be searched as raw bytes
+template<typename B>
+constexpr bool is_byte_v = sizeof(B) == 1 && (std::is_integral_v<B> || std::is_same_v<B, std::byte>);
+
+enum class isa { scalar, sse2, avx2 };
+
+/// \brief one implementation of each kernel
+///
+/// All of them work on [first, last) and return `last` when nothing is
+/// found.
+struct kernel_table {
+  const byte* (*find)(const byte* first, const byte* last, byte value);
+  std::size_t (*count)(const byte* first, const byte* last, byte value);
+  const byte* (*find_first_of)(const byte* first, const byte* last, const byte* set, std::size_t set_size);
+  const byte* (*search)(const byte* first, const byte* last, const byte* needle, std::size_t needle_size);
+};
+
+namespace detail {
+
+// ------ scalar ------
+
+inline const byte* find_scalar(const byte* first, const byte* last, byte value) {
+  if (first == last) return last;
+  auto p = static_cast<const byte*>(std::memchr(first, value, last - first));
+  return p ? p : last;
+}
+
+inline std::size_t count_scalar(const byte* first, const byte* last, byte value) {
+  std::size_t n = 0;
+  for (; first != last; ++first) n += *first == value;
+  return n;
+}
+
+inline const byte* find_first_of_scalar(const byte* first, const byte* last,
+                                        const byte* set, std::size_t set_size) {
+  bool in_set[256] = {};
+  for (std::size_t i = 0; i < set_size; ++i) in_set[set[i]] = true;
+  for (; first != last; ++first)
+    if (in_set[*first]) return first;
+  return last;
+}
+
+inline const byte* search_scalar(const byte* first, const byte* last,
+                                 const byte* needle, std::size_t needle_size) {
+  if (needle_size == 0) return first;
+  if (std::size_t(last - first) < needle_size) return last;
+
+  const byte* candidates_end = last - needle_size + 1;
+  for (const byte* p = first; p != candidates_end; ++p) {
+    p = find_scalar(p, candidates_end, needle[0]);
+    if (p == candidates_end) break;
+    if (std::memcmp(p + 1, needle + 1, needle_size - 1) == 0) return p;
+  }
+  return last;
+}
+
+/// Sets larger than this are searched with the scalar lookup table.
+constexpr std::size_t max_vector_set = 16;
+
+#ifdef DR_SIMD_X86
+
+inline unsigned lowest_bit(unsigned mask) { return unsigned(__builtin_ctz(mask)); }
+
+// ------ SSE2 ------
+
+__attribute__((target("sse2")))
+inline const byte* find_sse2(const byte* first, const byte* last, byte value) {
+  const __m128i v = _mm_set1_epi8(char(value));
+  // four blocks are tested at once; the one holding the match is found
+  // by the single-block loop below
+  for (; last - first >= 64; first += 64) {
+    auto blocks = reinterpret_cast<const __m128i*>(first);
+    __m128i hits = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(_mm_loadu_si128(blocks), v), _mm_cmpeq_epi8(_mm_loadu_si128(blocks + 1), v)),
+        _mm_or_si128(_mm_cmpeq_epi8(_mm_loadu_si128(blocks + 2), v), _mm_cmpeq_epi8(_mm_loadu_si128(blocks + 3), v)));
+    if (_mm_movemask_epi8(hits)) break;
+  }
+  for (; last - first >= 16; first += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    unsigned mask = unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(block, v)));
+    if (mask) return first + lowest_bit(mask);
+  }
+  for (; first != last; ++first)
+    if (*first == value) return first;
+  return last;
+}
+
+__attribute__((target("sse2")))
+inline std::size_t count_sse2(const byte* first, const byte* last, byte value) {
+  const __m128i v = _mm_set1_epi8(char(value));
+  std::size_t n = 0;
+  while (last - first >= 16) {
+    // the per-lane byte counters are flushed before they can wrap
+    std::size_t blocks = std::min<std::size_t>((last - first) / 16, 255);
+    __m128i acc = _mm_setzero_si128();
+    for (std::size_t i = 0; i < blocks; ++i, first += 16) {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+      acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(block, v));
+    }
+    alignas(16) std::uint64_t sums[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(sums), _mm_sad_epu8(acc, _mm_setzero_si128()));
+    n += sums[0] + sums[1];
+  }
+  return n + count_scalar(first, last, value);
+}
+
+__attribute__((target("sse2")))
+inline const byte* find_first_of_sse2(const byte* first, const byte* last,
+                                      const byte* set, std::size_t set_size) {
+  if (set_size == 0) return last;
+  if (set_size > max_vector_set) return find_first_of_scalar(first, last, set, set_size);
+
+  __m128i v[max_vector_set];
+  for (std::size_t i = 0; i < set_size; ++i) v[i] = _mm_set1_epi8(char(set[i]));
+  for (; last - first >= 16; first += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    __m128i hits = _mm_cmpeq_epi8(block, v[0]);
+    for (std::size_t i = 1; i < set_size; ++i) hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, v[i]));
+    unsigned mask = unsigned(_mm_movemask_epi8(hits));
+    if (mask) return first + lowest_bit(mask);
+  }
+  return find_first_of_scalar(first, last, set, set_size);
+}
+
+/// Candidates are the positions whose first and last byte both match the
+/// needle; only those are compared in full.
+__attribute__((target("sse2")))
+inline const byte* search_sse2(const byte* first, const byte* last,
+                               const byte* needle, std::size_t needle_size) {
+  if (needle_size <= 1 || std::size_t(last - first) < needle_size)
+    return search_scalar(first, last, needle, needle_size);
+
+  const __m128i head = _mm_set1_epi8(char(needle[0]));
+  const __m128i tail = _mm_set1_epi8(char(needle[needle_size - 1]));
+  const byte* p = first;
+  for (; std::size_t(last - p) >= needle_size - 1 + 16; p += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + needle_size - 1));
+    unsigned mask = unsigned(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, head), _mm_cmpeq_epi8(b, tail))));
+    for (; mask; mask &= mask - 1) {
+      const byte* candidate = p + lowest_bit(mask);
+      if (std::memcmp(candidate + 1, needle + 1, needle_size - 2) == 0) return candidate;
+    }
+  }
+  return search_scalar(p, last, needle, needle_size);
+}
+
+// ------ AVX2 ------
+
+__attribute__((target("avx2")))
+inline const byte* find_avx2(const byte* first, const byte* last, byte value) {
+  const __m256i v = _mm256_set1_epi8(char(value));
+  for (; last - first >= 128; first += 128) {
+    auto blocks = reinterpret_cast<const __m256i*>(first);
+    __m256i hits = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256(blocks), v),
+                        _mm256_cmpeq_epi8(_mm256_loadu_si256(blocks + 1), v)),
+        _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256(blocks + 2), v),
+                        _mm256_cmpeq_epi8(_mm256_loadu_si256(blocks + 3), v)));
+    if (_mm256_movemask_epi8(hits)) break;
+  }
+  for (; last - first >= 32; first += 32) {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    unsigned mask = unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, v)));
+    if (mask) return first + lowest_bit(mask);
+  }
+  return find_sse2(first, last, value);
+}
+
+__attribute__((target("avx2")))
+inline std::size_t count_avx2(const byte* first, const byte* last, byte value) {
+  const __m256i v = _mm256_set1_epi8(char(value));
+  std::size_t n = 0;
+  while (last - first >= 32) {
+    std::size_t blocks = std::min<std::size_t>((last - first) / 32, 255);
+    __m256i acc = _mm256_setzero_si256();
+    for (std::size_t i = 0; i < blocks; ++i, first += 32) {
+      __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+      acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(block, v));
+    }
+    alignas(32) std::uint64_t sums[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(sums), _mm256_sad_epu8(acc, _mm256_setzero_si256()));
+    n += sums[0] + sums[1] + sums[2] + sums[3];
+  }
+  return n + count_sse2(first, last, value);
+}
+
+__attribute__((target("avx2")))
+inline const byte* find_first_of_avx2(const byte* first, const byte* last,
+                                      const byte* set, std::size_t set_size) {
+  if (set_size == 0) return last;
+  if (set_size > max_vector_set) return find_first_of_scalar(first, last, set, set_size);
+
+  __m256i v[max_vector_set];
+  for (std::size_t i = 0; i < set_size; ++i) v[i] = _mm256_set1_epi8(char(set[i]));
+  for (; last - first >= 32; first += 32) {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    __m256i hits = _mm256_cmpeq_epi8(block, v[0]);
+    for (std::size_t i = 1; i < set_size; ++i) hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, v[i]));
+    unsigned mask = unsigned(_mm256_movemask_epi8(hits));
+    if (mask) return first + lowest_bit(mask);
+  }
+  return find_first_of_sse2(first, last, set, set_size);
+}
+
+__attribute__((target("avx2")))
+inline const byte* search_avx2(const byte* first, const byte* last,
+                               const byte* needle, std::size_t needle_size) {
+  if (needle_size <= 1 || std::size_t(last - first) < needle_size)
+    return search_scalar(first, last, needle, needle_size);
+
+  const __m256i head = _mm256_set1_epi8(char(needle[0]));
+  const __m256i tail = _mm256_set1_epi8(char(needle[needle_size - 1]));
+  const byte* p = first;
+  for (; std::size_t(last - p) >= needle_size - 1 + 32; p += 32) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + needle_size - 1));
+    unsigned mask = unsigned(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(a, head), _mm256_cmpeq_epi8(b, tail))));
+    for (; mask; mask &= mask - 1) {
+      const byte* candidate = p + lowest_bit(mask);
+      if (std::memcmp(candidate + 1, needle + 1, needle_size - 2) == 0) return candidate;
+    }
+  }
+  return search_sse2(p, last, needle, needle_size);
+}
+
+#endif
+
+}
+
+/// \brief the most capable instruction set of this CPU
+inline isa best_isa() {
+#ifdef DR_SIMD_X86
+  static const isa best = __builtin_cpu_supports("avx2") ? isa::avx2
+                          : __builtin_cpu_supports("sse2") ? isa::sse2
+                          : isa::scalar;
+  return best;
+#else
+  return isa::scalar;
+#endif
+}
+
+/// \brief the kernels for `level`, or for best_isa() if the CPU does not
+/// support `level`
+inline const kernel_table& kernels(isa level = best_isa()) {
+  using namespace detail;
+  static const kernel_table scalar{find_scalar, count_scalar, find_first_of_scalar, search_scalar};
+#ifdef DR_SIMD_X86
+  static const kernel_table sse2{find_sse2, count_sse2, find_first_of_sse2, search_sse2};
+  static const kernel_table avx2{find_avx2, count_avx2, find_first_of_avx2, search_avx2};
+
+  switch (std::min(level, best_isa())) {
+  case isa::avx2: return avx2;
+  case isa::sse2: return sse2;
+  default: return scalar;
+  }
+#else
+  (void) level;
+  return scalar;
+#endif
+}
+
+/// \brief memchr: the first element equal to `value`
+template<typename B, std::enable_if_t<is_byte_v<B>, int> = 0>
+const B* find(const B* first, const B* last, B value) {
+  auto p = reinterpret_cast<const byte*>(first);
+  return first + (kernels().find(p, p + (last - first), byte(value)) - p);
+}
+
+template<typename B, std::enable_if_t<is_byte_v<B>, int> = 0>
+std::size_t count(const B* first, const B* last, B value) {
+  auto p = reinterpret_cast<const byte*>(first);
+  return kernels().count(p, p + (last - first), byte(value));
+}
+
+/// \brief the first element equal to any of [s_first, s_last)
+template<typename B, std::enable_if_t<is_byte_v<B>, int> = 0>
+const B* find_first_of(const B* first, const B* last, const B* s_first, const B* s_last) {
+  auto p = reinterpret_cast<const byte*>(first);
+  return first + (kernels().find_first_of(p, p + (last - first),
+                                          reinterpret_cast<const byte*>(s_first), s_last - s_first) - p);
+}
+
+/// \brief the first occurrence of [s_first, s_last)
+template<typename B, std::enable_if_t<is_byte_v<B>, int> = 0>
+const B* search(const B* first, const B* last, const B* s_first, const B* s_last) {
+  auto p = reinterpret_cast<const byte*>(first);
+  return first + (kernels().search(p, p + (last - first),
+                                   reinterpret_cast<const byte*>(s_first), s_last - s_first) - p);
+}
+
+}
+}
@@ -0,0 +1,559 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <gsl/gsl>
+
+namespace dr {
+
+/// \brief overflow policy of static_gap_buffer: an insertion that does not
+/// fit throws std::length_error and leaves the buffer unchanged
+///
+/// In a constant expression the throw makes the overflow a compile error.
+struct throw_on_overflow {
+  /// \return how many of `count` elements to insert when `available` fit
+  static constexpr std::size_t admit(std::size_t count, std::size_t available) {
+    if (count > available) throw std::length_error("static_gap_buffer capacity exceeded");
+    return count;
+  }
+};
+
+/// \brief overflow policy of static_gap_buffer: an insertion keeps the
+/// elements that fit and drops the rest
+struct truncate_on_overflow {
+  static constexpr std::size_t admit(std::size_t count, std::size_t available) noexcept {
+    return count < available ? count : available;
+  }
+};
+
+/// \brief gap buffer of at most N elements stored in the object itself
+///
+/// The interface follows gap_buffer, but the buffer never allocates:
+/// capacity() is always N. Insertions that do not fit are handled by
+/// `OverflowPolicy`, see throw_on_overflow and truncate_on_overflow; the
+/// try_insert and try_push_back members instead report with their return
+/// value whether the elements fit, whatever the policy.
+///
+/// The gap holds value-initialized elements, so T must be default
+/// constructible and assignable. For trivially copyable T the buffer is
+/// itself trivially copyable and all members can be used in constant
+/// expressions. The gap is kept as two positions rather than pointers,
+/// so copies need no fixing up.
+///
+/// Iterators are (container, storage position) pairs; as with gap_buffer
+/// they are invalidated by insertion and erasure.
+template<typename T,
+         std::size_t N,
+         typename OverflowPolicy = throw_on_overflow>
+struct static_gap_buffer {
+  static_assert(N > 0, "static_gap_buffer needs a capacity");
+  static_assert(std::is_default_constructible_v<T>, "static_gap_buffer needs a default constructible value_type");
+
+  using value_type      = T;
+  using overflow_policy = OverflowPolicy;
+  using size_type       = std::size_t;
+  using difference_type = ptrdiff_t;
+  using reference       = value_type&;
+  using const_reference = const value_type&;
+  using pointer         = value_type*;
+  using const_pointer   = const value_type*;
+
+  using span_type       = gsl::span<value_type>;
+  using const_span_type = gsl::span<const value_type>;
+  using span_pair       = std::pair<span_type, span_type>;
+  using const_span_pair = std::pair<const_span_type, const_span_type>;
+
+  template<bool Const>
+  struct basic_iterator {
+    using self_type         = basic_iterator;
+    using container_pointer = std::conditional_t<Const, const static_gap_buffer*, static_gap_buffer*>;
+
+    using value_type        = static_gap_buffer::value_type;
+    using difference_type   = static_gap_buffer::difference_type;
+    using reference         = std::conditional_t<Const, const_reference, static_gap_buffer::reference>;
+    using pointer           = std::conditional_t<Const, const_pointer, static_gap_buffer::pointer>;
+    using iterator_category = std::random_access_iterator_tag;
+
+    constexpr explicit basic_iterator(container_pointer container = nullptr, difference_type offset = 0)
+        : container(container), pos(container ? container->to_position(offset) : 0) { }
+
+    template<bool C = Const, typename = std::enable_if_t<C>>
+    constexpr basic_iterator(const basic_iterator<false>& other)
+        : container(other.container), pos(other.pos) { }
+
+    constexpr reference operator [](difference_type i) const {
+      return *(*this + i);
+    }
+
+    constexpr reference operator *() const {
+      return container->elements[pos];
+    }
+
+    constexpr pointer operator ->() const {
+      return &container->elements[pos];
+    }
+
+    constexpr self_type& operator ++() {
+      if (++pos == container->gap_start) pos += container->gap_size;
+      return *this;
+    }
+
+    constexpr self_type operator ++(int) {
+      self_type retval = *this;
+      this->operator ++();
+      return retval;
+    }
+
+    constexpr self_type& operator --() {
+      if (pos == container->gap_start + container->gap_size) pos = container->gap_start;
+      --pos;
+      return *this;
+    }
+
+    constexpr self_type operator --(int) {
+      self_type retval = *this;
+      this->operator --();
+      return retval;
+    }
+
+    constexpr bool operator ==(const self_type& other) const {
+      return container == other.container && pos == other.pos;
+    }
+
+    constexpr bool operator !=(const self_type& other) const {
+      return !(*this == other);
+    }
+
+    constexpr bool operator <(const self_type& other) const {
+      Expects(container == other.container);
+      return pos < other.pos;
+    }
+
+    constexpr bool operator >(const self_type& other) const {
+      return other < *this;
+    }
+
+    constexpr bool operator <=(const self_type& other) const {
+      return !(other < *this);
+    }
+
+    constexpr bool operator >=(const self_type& other) const {
+      return !(*this < other);
+    }
+
+    constexpr self_type& operator +=(difference_type n) {
+      pos = container->to_position(offset() + n);
+      return *this;
+    }
+
+    friend
+    constexpr self_type operator +(self_type it, difference_type n) {
+      return it += n;
+    }
+
+    friend
+    constexpr self_type operator +(difference_type n, self_type it) {
+      return it += n;
+    }
+
+    constexpr self_type& operator -=(difference_type n) {
+      return *this += -n;
+    }
+
+    constexpr self_type operator -(difference_type n) const {
+      self_type retval = *this;
+      return retval -= n;
+    }
+
+    constexpr difference_type operator -(const self_type& other) const {
+      Expects(container == other.container);
+      return offset() - other.offset();
+    }
+
+    /// \brief [first, last) as at most two contiguous spans, see gap_buffer::segments
+    friend
+    constexpr std::conditional_t<Const, const_span_pair, span_pair> segments(self_type first, self_type last) {
+      return first.container->segments(first, last);
+    }
+
+    friend struct static_gap_buffer;
+    template<bool> friend struct basic_iterator;
+
+  private:
+    constexpr difference_type offset() const { return container ? container->to_offset(pos) : 0; }
+
+    container_pointer container;
+    size_type pos;
+  };
+
+  using iterator               = basic_iterator<false>;
+  using const_iterator         = basic_iterator<true>;
+  using reverse_iterator       = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  constexpr static_gap_buffer() noexcept(std::is_nothrow_default_constructible_v<T>) = default;
+
+  constexpr static_gap_buffer(size_type count, const T& value) {
+    insert(end(), count, value);
+  }
+
+  template<typename InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+  constexpr static_gap_buffer(InputIt first, InputIt last) {
+    insert(end(), first, last);
+  }
+
+  constexpr static_gap_buffer(std::initializer_list<T> ilist) {
+    insert(end(), ilist.begin(), ilist.end());
+  }
+
+  /// \brief copy of a buffer whose capacity is known to fit
+  template<std::size_t M, typename P>
+  constexpr explicit static_gap_buffer(const static_gap_buffer<T, M, P>& rhs) {
+    static_assert(M <= N, "the source buffer may hold more elements than fit");
+    insert(end(), rhs.begin(), rhs.end());
+  }
+
+  template<std::size_t M>
+  constexpr explicit static_gap_buffer(const std::array<T, M>& a) {
+    static_assert(M <= N, "the array holds more elements than fit");
+    insert(end(), a.begin(), a.end());
+  }
+
+  constexpr void swap(static_gap_buffer& rhs) noexcept(std::is_nothrow_swappable_v<T>) {
+    using std::swap;
+    for (size_type i = 0; i < N; ++i) swap(elements[i], rhs.elements[i]);
+    swap(gap_start, rhs.gap_start);
+    swap(gap_size, rhs.gap_size);
+  }
+
+  constexpr void assign(size_type count, const T& value) {
+    clear();
+    insert(end(), count, value);
+  }
+
+  template<typename InputIt>
+  constexpr void assign(InputIt first, InputIt last) {
+    clear();
+    insert(end(), first, last);
+  }
+
+  constexpr void assign(std::initializer_list<T> ilist) { assign(ilist.begin(), ilist.end()); }
+
+  constexpr const_reference operator [](size_type pos) const {
+    if (pos < gap_start) return elements[pos];
+    else return elements[pos + gap_size];
+  }
+
+  constexpr reference operator [](size_type pos) {
+    return const_cast<reference>(
+        static_cast<const static_gap_buffer&>(*this)[pos]
+    );
+  }
+
+  constexpr const_reference at(size_type pos) const {
+    if (pos >= size()) throw std::out_of_range("index out of range");
+    return (*this)[pos];
+  }
+
+  constexpr reference at(size_type pos) {
+    return const_cast<reference>(
+        static_cast<const static_gap_buffer&>(*this).at(pos)
+    );
+  }
+
+  constexpr const_reference front() const { return (*this)[0]; }
+  constexpr reference front() { return (*this)[0]; }
+
+  constexpr const_reference back() const { return (*this)[size() - 1]; }
+  constexpr reference back() { return (*this)[size() - 1]; }
+
+  constexpr size_type size() const noexcept { return N - gap_size; }
+  constexpr size_type max_size() const noexcept { return N; }
+  constexpr size_type capacity() const noexcept { return N; }
+
+  /// \brief how many more elements fit
+  constexpr size_type available() const noexcept { return gap_size; }
+
+  [[nodiscard]] constexpr bool empty() const noexcept { return gap_size == N; }
+  constexpr bool full() const noexcept { return gap_size == 0; }
+
+  /// \brief the elements before and after the gap as two contiguous spans
+  constexpr const_span_pair segments() const noexcept { return segments(begin(), end()); }
+  constexpr span_pair segments() noexcept { return segments(begin(), end()); }
+
+  /// \brief the elements of [first, last) as at most two contiguous spans
+  constexpr const_span_pair segments(const_iterator first, const_iterator last) const {
+    Expects(first.container == this && last.container == this && first <= last);
+    auto[f, l] = segment_bounds(first.pos, last.pos);
+    return {const_span_type(elements + f.first, f.second - f.first),
+            const_span_type(elements + l.first, l.second - l.first)};
+  }
+
+  constexpr span_pair segments(const_iterator first, const_iterator last) {
+    Expects(first.container == this && last.container == this && first <= last);
+    auto[f, l] = segment_bounds(first.pos, last.pos);
+    return {span_type(elements + f.first, f.second - f.first),
+            span_type(elements + l.first, l.second - l.first)};
+  }
+
+  /// \brief move the gap to the end and view all elements as one span
+  constexpr span_type contiguous_view() {
+    relocate_gap(size());
+    return span_type(elements, size());
+  }
+
+  /// \brief move the gap to `pos` and return all of it
+  ///
+  /// The caller fills the front of the returned span in place, e.g. with
+  /// read(2), and then hands the written elements over with `commit`.
+  constexpr span_type prepare(const_iterator pos) {
+    Expects(this == pos.container);
+    relocate_gap(pos.offset());
+    return span_type(elements + gap_start, gap_size);
+  }
+
+  /// \brief make the first `n` elements of the gap part of the buffer
+  constexpr void commit(size_type n) {
+    Expects(n <= gap_size);
+    gap_start += n;
+    gap_size -= n;
+  }
+
+  constexpr void clear() { erase(begin(), end()); }
+
+  constexpr void resize(size_type count, const value_type& value = value_type{}) {
+    if (count < size())
+      erase(begin() + count, end());
+    else
+      insert(end(), count - size(), value);
+  }
+
+  constexpr iterator erase(const_iterator first, const_iterator last) {
+    Expects(first.container == this && last.container == this && first <= last);
+    difference_type offset = first.offset();
+    size_type num_to_erase = size_type(last - first);
+    relocate_gap(offset);
+    if constexpr (!std::is_trivially_copyable_v<T>) {
+      // erased elements release what they hold
+      for (size_type i = 0; i < num_to_erase; ++i) elements[gap_start + gap_size + i] = T();
+    }
+    gap_size += num_to_erase;
+    return iterator(this, offset);
+  }
+
+  constexpr iterator erase(const_iterator pos) { return erase(pos, pos + 1); }
+
+  /// \return iterator to the first inserted element
+  template<typename InputIt>
+  constexpr iterator insert(const_iterator pos, InputIt first, InputIt last) {
+    Expects(this == pos.container && pos <= end());
+    size_type count = OverflowPolicy::admit(size_type(std::distance(first, last)), gap_size);
+    return insert_admitted(pos.offset(), count, [&] { return *first++; });
+  }
+
+  constexpr iterator insert(const_iterator pos, std::initializer_list<T> ilist) {
+    return insert(pos, ilist.begin(), ilist.end());
+  }
+
+  constexpr iterator insert(const_iterator pos, size_type count, const T& value) {
+    Expects(this == pos.container && pos <= end());
+    count = OverflowPolicy::admit(count, gap_size);
+    T copy = value;
+    return insert_admitted(pos.offset(), count, [&] { return copy; });
+  }
+
+  constexpr iterator insert(const_iterator pos, const T& value) { return emplace(pos, value); }
+
+  constexpr iterator insert(const_iterator pos, T&& value) { return emplace(pos, std::move(value)); }
+
+  /// \brief insert an element made from `args`; under truncate_on_overflow
+  /// it is dropped if the buffer is full
+  template<typename ... Args>
+  constexpr iterator emplace(const_iterator pos, Args&& ... args) {
+    Expects(this == pos.container && pos <= end());
+    size_type count = OverflowPolicy::admit(1, gap_size);
+    // made before the gap moves, which may displace an element in `args`
+    T value(std::forward<Args>(args)...);
+    return insert_admitted(pos.offset(), count, [&] { return std::move(value); });
+  }
+
+  constexpr void push_back(const T& value) { emplace(end(), value); }
+  constexpr void push_back(T&& value) { emplace(end(), std::move(value)); }
+  constexpr void pop_back() { erase(end() - 1); }
+
+  /// \brief insert [first, last) if all of it fits
+  /// \return whether the elements were inserted
+  template<typename InputIt>
+  constexpr bool try_insert(const_iterator pos, InputIt first, InputIt last) {
+    Expects(this == pos.container && pos <= end());
+    size_type count = size_type(std::distance(first, last));
+    if (count > gap_size) return false;
+    insert_admitted(pos.offset(), count, [&] { return *first++; });
+    return true;
+  }
+
+  constexpr bool try_insert(const_iterator pos, const T& value) {
+    Expects(this == pos.container && pos <= end());
+    if (full()) return false;
+    T copy = value;
+    insert_admitted(pos.offset(), 1, [&] { return copy; });
+    return true;
+  }
+
+  constexpr bool try_push_back(const T& value) { return try_insert(end(), value); }
+
+  constexpr const_iterator begin() const noexcept { return const_iterator(this); }
+  constexpr const_iterator cbegin() const noexcept { return begin(); }
+
+  constexpr const_iterator end() const noexcept { return const_iterator(this, size()); }
+  constexpr const_iterator cend() const noexcept { return end(); }
+
+  constexpr iterator begin() noexcept { return iterator(this); }
+  constexpr iterator end() noexcept { return iterator(this, size()); }
+
+  constexpr const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+  constexpr const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+
+  constexpr const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+  constexpr const_reverse_iterator crend() const noexcept { return rend(); }
+
+  constexpr reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+  constexpr reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
+
+  friend
+  constexpr bool operator ==(const static_gap_buffer& lhs, const static_gap_buffer& rhs) {
+    if (lhs.size() != rhs.size()) return false;
+    for (size_type i = 0; i < lhs.size(); ++i)
+      if (!(lhs[i] == rhs[i])) return false;
+    return true;
+  }
+
+  friend
+  constexpr bool operator !=(const static_gap_buffer& lhs, const static_gap_buffer& rhs) {
+    return !(lhs == rhs);
+  }
+
+  friend
+  constexpr bool operator <(const static_gap_buffer& lhs, const static_gap_buffer& rhs) {
+    size_type n = lhs.size() < rhs.size() ? lhs.size() : rhs.size();
+    for (size_type i = 0; i < n; ++i) {
+      if (lhs[i] < rhs[i]) return true;
+      if (rhs[i] < lhs[i]) return false;
+    }
+    return lhs.size() < rhs.size();
+  }
+
+  friend
+  constexpr bool operator >(const static_gap_buffer& lhs, const static_gap_buffer& rhs) {
+    return rhs < lhs;
+  }
+
+  friend
+  constexpr bool operator <=(const static_gap_buffer& lhs, const static_gap_buffer& rhs) {
+    return !(rhs < lhs);
+  }
+
+  friend
+  constexpr bool operator >=(const static_gap_buffer& lhs, const static_gap_buffer& rhs) {
+    return !(lhs < rhs);
+  }
+
+  // additional
+  template<typename InputIt>
+  constexpr void append(InputIt first, InputIt last) {
+    insert(end(), first, last);
+  }
+
+  constexpr void append(const T& value) { push_back(value); }
+
+  constexpr void append(T&& value) { push_back(std::move(value)); }
+
+  template<typename InputIt>
+  constexpr void replace(const_iterator f1, const_iterator l1, InputIt f2, InputIt l2) {
+    auto cursor = erase(f1, l1);
+    insert(cursor, f2, l2);
+  }
+
+  template<typename InputIt>
+  constexpr void replace(const_iterator pos, InputIt first, InputIt last) {
+    replace(pos, pos + 1, first, last);
+  }
+
+  constexpr static_gap_buffer substr(const_iterator first, const_iterator last) const {
+    return static_gap_buffer(first, last);
+  }
+
+protected:
+  /// \brief storage position of the element at logical position `offset`
+  ///
+  /// Positions at or past the gap map behind it, so the past-the-end
+  /// position is always N.
+  constexpr size_type to_position(difference_type offset) const {
+    if (size_type(offset) < gap_start) return size_type(offset);
+    else return size_type(offset) + gap_size;
+  }
+
+  /// \brief logical position of the element stored at `pos`
+  constexpr difference_type to_offset(size_type pos) const {
+    if (pos < gap_start) return difference_type(pos);
+    else return difference_type(pos - gap_size);
+  }
+
+  /// \return [begin, end) position pairs of the pre-gap and post-gap parts
+  /// of the range between the storage positions `first` and `last`
+  constexpr std::pair<std::pair<size_type, size_type>, std::pair<size_type, size_type>>
+  segment_bounds(size_type first, size_type last) const {
+    size_type gap_end = gap_start + gap_size;
+    std::pair<size_type, size_type> front(gap_start, gap_start);
+    std::pair<size_type, size_type> back(gap_end, gap_end);
+    if (first < gap_start)
+      front = {first, last < gap_start ? last : gap_start};
+    if (last > gap_end)
+      back = {first > gap_end ? first : gap_end, last};
+    return {front, back};
+  }
+
+  /// Elements are moved one by one; for trivially copyable T compilers
+  /// turn these loops into memmove.
+  constexpr void relocate_gap(difference_type offset) {
+    size_type target = size_type(offset);
+    if (gap_start < target) {
+      for (size_type i = gap_start; i < target; ++i) elements[i] = std::move(elements[i + gap_size]);
+    }
+    else {
+      for (size_type i = gap_start; i > target; --i) elements[i - 1 + gap_size] = std::move(elements[i - 1]);
+    }
+    gap_start = target;
+  }
+
+  /// \brief insert `count` elements at `offset`, each the result of
+  /// `next()`; the caller has made sure they fit
+  template<typename F>
+  constexpr iterator insert_admitted(difference_type offset, size_type count, F next) {
+    relocate_gap(offset);
+    for (size_type i = 0; i < count; ++i) {
+      elements[gap_start] = next();
+      ++gap_start;
+      --gap_size;
+    }
+    return iterator(this, offset);
+  }
+
+private:
+  T elements[N] {};
+  size_type gap_start = 0;
+  size_type gap_size = N;
+};
+
+template<typename T, std::size_t N, typename OverflowPolicy>
+constexpr void swap(static_gap_buffer<T, N, OverflowPolicy>& lhs,
+                    static_gap_buffer<T, N, OverflowPolicy>& rhs) noexcept(noexcept(lhs.swap(rhs))) {
+  lhs.swap(rhs);
+}
+
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dr {
+
+/// \brief a fixed set of threads which run the iterations of a loop
+///
+/// parallel_for() hands out the indices of a loop one at a time to the
+/// workers and to the calling thread, and returns when all are done. One
+/// loop runs at a time; a loop started from inside a loop runs on the
+/// calling thread alone.
+struct thread_pool {
+  using size_type = std::size_t;
+
+  /// \param threads number of threads working on a loop, the caller included
+  explicit thread_pool(unsigned threads = std::thread::hardware_concurrency()) {
+    for (unsigned i = 1; i < threads; ++i) workers.emplace_back([this] { work(); });
+  }
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator =(const thread_pool&) = delete;
+
+  ~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(m);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (auto& t : workers) t.join();
+  }
+
+  /// \brief a pool with a thread per core, created on first use
+  static thread_pool& shared() {
+    static thread_pool pool;
+    return pool;
+  }
+
+  unsigned size() const noexcept { return unsigned(workers.size()) + 1; }
+
+  /// \brief call `f(i)` for every i in [0, n), spread over the threads
+  ///
+  /// The first exception thrown by `f` is rethrown once all threads have
+  /// stopped; the indices not started by then are skipped.
+  template<typename F>
+  void parallel_for(size_type n, F&& f) {
+    if (n == 0) return;
+    if (n == 1 || workers.empty() || in_worker() || in_loop()) {
+      for (size_type i = 0; i < n; ++i) f(i);
+      return;
+    }
+
+    std::lock_guard<std::mutex> one_loop(submit);
+    job j;
+    j.count = n;
+    j.context = &f;
+    j.call = [](void* context, size_type i) { (*static_cast<F*>(context))(i); };
+    {
+      std::lock_guard<std::mutex> lock(m);
+      current = &j;
+      ++generation;
+    }
+    wake.notify_all();
+
+    in_loop() = true;
+    run(j);
+    in_loop() = false;
+
+    std::unique_lock<std::mutex> lock(m);
+    current = nullptr;
+    idle.wait(lock, [&] { return j.users == 0; });
+    if (j.error) std::rethrow_exception(j.error);
+  }
+
+protected:
+  struct job {
+    size_type count = 0;
+    std::atomic<size_type> next{0};
+    void* context = nullptr;
+    void (*call)(void*, size_type) = nullptr;
+    size_type users = 0;  ///< workers on the job, guarded by m
+    std::exception_ptr error;
+  };
+
+  static bool& in_worker() {
+    thread_local bool flag = false;
+    return flag;
+  }
+
+  /// set while the calling thread runs iterations of its own loop
+  static bool& in_loop() {
+    thread_local bool flag = false;
+    return flag;
+  }
+
+  void run(job& j) {
+    for (size_type i; (i = j.next.fetch_add(1, std::memory_order_relaxed)) < j.count;) {
+      try {
+        j.call(j.context, i);
+      }
+      catch (...) {
+        std::lock_guard<std::mutex> lock(m);
+        if (!j.error) j.error = std::current_exception();
+        j.next.store(j.count, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void work() {
+    in_worker() = true;
+    std::uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(m);
+    for (;;) {
+      wake.wait(lock, [&] { return stopping || (current && generation != seen); });
+      if (stopping) return;
+
+      seen = generation;
+      job& j = *current;
+      ++j.users;
+      lock.unlock();
+      run(j);
+      lock.lock();
+      if (--j.users == 0) idle.notify_all();
+    }
+  }
+
+private:
+  std::vector<std::thread> workers;
+  std::mutex submit;  ///< held by the thread running a loop
+
+  std::mutex m;
+  std::condition_variable wake;
+  std::condition_variable idle;
+  job* current = nullptr;
+  std::uint64_t generation = 0;
+  bool stopping = false;
+};
+
+}
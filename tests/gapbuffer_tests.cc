@@ -2,10 +2,35 @@
 // Created by robin on 09/04/2018.
 //
 
+// The suite runs in the default configuration. Build it once more with
+// -DDR_GAP_BUFFER_STATS to test the storage stats as well; the macro must
+// be the same in every translation unit, see gap_buffer_stats.h.
+
 #define CATCH_CONFIG_MAIN
 
+#include <algorithm>
+#include <cctype>
+#include <atomic>
+#include <memory>
+#include <random>
+#include <thread>
+#include <tuple>
+#include <vector>
+
 #include "catch.hpp"
 #include "gap_buffer.h"
+#include "gap_buffer_arena.h"
+#include "mmap_allocator.h"
+#include "gap_buffer_io.h"
+#include "chunked_gap_buffer.h"
+#include "concurrent_buffer.h"
+#include "parallel_algorithm.h"
+#include "static_gap_buffer.h"
+#include "segmented_search.h"
+#include "line_index.h"
+#include "content_hash.h"
+#include "marker_set.h"
+#include "edit_journal.h"
 
 TEST_CASE("Gapbuffer are initialized", "[gapbuffer]") {
 
@@ -153,4 +178,1761 @@ TEST_CASE("Gapbuffer are initialized", "[gapbuffer]") {
     CHECK(gb8.empty());
   }
 
-}
\ No newline at end of file
+}
+
+TEST_CASE("Gapbuffer exposes its segments", "[gapbuffer]") {
+
+  SECTION("Segments around the gap") {
+    dr::gap_buffer<char> gb1{'a', 'b', 'c', 'd', 'e', 'f'};
+    gb1.insert(gb1.begin() + 2, 'x');
+    auto[front, back] = gb1.segments();
+    CHECK(std::string(front.begin(), front.end()) == "abx");
+    CHECK(std::string(back.begin(), back.end()) == "cdef");
+
+    auto[f2, b2] = gb1.segments(gb1.begin() + 1, gb1.begin() + 5);
+    CHECK(std::string(f2.begin(), f2.end()) == "bx");
+    CHECK(std::string(b2.begin(), b2.end()) == "cd");
+
+    auto[f3, b3] = gb1.segments(gb1.begin() + 4, gb1.end());
+    CHECK(f3.empty());
+    CHECK(std::string(b3.begin(), b3.end()) == "def");
+
+    dr::gap_buffer<char> gb2(0);
+    auto[f4, b4] = gb2.segments();
+    CHECK(f4.empty());
+    CHECK(b4.empty());
+  }
+
+  SECTION("Contiguous view") {
+    dr::gap_buffer<char> gb1{'a', 'b', 'c', 'd'};
+    gb1.insert(gb1.begin() + 1, 'x');
+    auto view = gb1.contiguous_view();
+    CHECK(std::string(view.begin(), view.end()) == "axbcd");
+    CHECK(gb1.segments().second.empty());
+  }
+
+}
+
+TEST_CASE("Gapbuffer iterators walk across the gap", "[gapbuffer]") {
+
+  dr::gap_buffer<char> gb1{'a', 'b', 'c', 'd', 'e', 'f'};
+  gb1.insert(gb1.begin() + 3, 'x');
+
+  SECTION("Stepping and arithmetic") {
+    CHECK(std::string(gb1.begin(), gb1.end()) == "abcxdef");
+    CHECK(std::string(gb1.rbegin(), gb1.rend()) == "fedxcba");
+    CHECK(gb1.end() - gb1.begin() == 7);
+    CHECK(*(gb1.begin() + 4) == 'd');
+    CHECK(*(gb1.end() - 3) == 'd');
+    CHECK(gb1.begin()[5] == 'e');
+    CHECK(gb1.begin() + 7 == gb1.end());
+
+    auto it = gb1.begin() + 3;
+    CHECK(*++it == 'd');
+    CHECK(*--it == 'x');
+    CHECK(*--it == 'c');
+    CHECK(gb1.begin() < it);
+  }
+
+  SECTION("Segmented algorithms") {
+    std::string s;
+    dr::copy(gb1.begin(), gb1.end(), std::back_inserter(s));
+    CHECK(s == "abcxdef");
+
+    CHECK(dr::find(gb1.cbegin(), gb1.cend(), 'e') == gb1.cbegin() + 5);
+    CHECK(dr::find(gb1.cbegin(), gb1.cend(), 'x') == gb1.cbegin() + 3);
+    CHECK(dr::find(gb1.cbegin(), gb1.cend(), 'z') == gb1.cend());
+    CHECK(dr::count(gb1.begin() + 1, gb1.end(), 'a') == 0);
+
+    int visited = 0;
+    dr::for_each(gb1.begin(), gb1.end(), [&](char& c) { c = char(c - 'a' + 'A'); ++visited; });
+    CHECK(visited == 7);
+    CHECK(gb1[3] == 'X');
+
+    dr::gap_buffer<char> gb2{'A', 'B', 'C', 'X', 'D', 'E', 'F'};
+    CHECK(dr::equal(gb1.begin(), gb1.end(), gb2.begin(), gb2.end()));
+    gb2[4] = 'Q';
+    auto[left, right] = dr::mismatch(gb1.begin(), gb1.end(), gb2.begin(), gb2.end());
+    CHECK(left == gb1.begin() + 4);
+    CHECK(right == gb2.begin() + 4);
+  }
+
+  SECTION("Comparison") {
+    dr::gap_buffer<char> gb2{'a', 'b', 'c', 'x', 'd', 'e', 'f'};
+    CHECK(gb1 == gb2);
+    gb2.pop_back();
+    CHECK(gb2 != gb1);
+    CHECK(gb2 < gb1);
+    gb2.insert(gb2.begin(), 'b');
+    CHECK(gb1 < gb2);
+  }
+
+  SECTION("Comparison of long contents") {
+    // the differing byte in and past the 64-byte blocks, on either side
+    // of both gaps
+    std::string s(300, 'm');
+    for (std::size_t diff : {0, 63, 64, 130, 299}) {
+      for (std::size_t gap : {0, 70, 200}) {
+        std::string t = s;
+        t[diff] = char(-3);
+        dr::gap_buffer<char> gb3(s.begin(), s.end()), gb4(t.begin(), t.end());
+        gb3.insert(gb3.begin() + gap, 'k');
+        gb3.erase(gb3.begin() + gap);
+        auto[left, right] = dr::mismatch(gb3.begin(), gb3.end(), gb4.begin(), gb4.end());
+        CHECK(left - gb3.begin() == std::ptrdiff_t(diff));
+        CHECK(right - gb4.begin() == std::ptrdiff_t(diff));
+        CHECK((gb3 < gb4) == std::lexicographical_compare(s.begin(), s.end(), t.begin(), t.end()));
+        CHECK((gb4 < gb3) == std::lexicographical_compare(t.begin(), t.end(), s.begin(), s.end()));
+      }
+    }
+  }
+
+}
+
+TEST_CASE("Gapbuffer constructs elements in place", "[gapbuffer]") {
+
+  SECTION("Move-only elements") {
+    dr::gap_buffer<std::unique_ptr<int>> gb;
+    for (int i = 0; i < 100; ++i) gb.emplace_back(new int(i));
+    gb.emplace(gb.begin() + 10, std::make_unique<int>(-1));
+    gb.insert(gb.begin(), std::make_unique<int>(-2));
+    gb.erase(gb.begin() + 50, gb.begin() + 60);
+    gb.shrink_to_fit();
+    CHECK(gb.size() == 92);
+    CHECK(*gb[0] == -2);
+    CHECK(*gb[1] == 0);
+    CHECK(*gb[11] == -1);
+
+    dr::gap_buffer<std::unique_ptr<int>> moved(std::move(gb));
+    CHECK(*moved.back() == 99);
+  }
+
+  // not default constructible; counts the live objects and the moves
+  struct tracked {
+    tracked(int* live, int* moves, int value) : live(live), moves(moves), value(value) { ++*live; }
+    tracked(const tracked& rhs) : live(rhs.live), moves(rhs.moves), value(rhs.value) { ++*live; }
+    tracked(tracked&& rhs) noexcept : live(rhs.live), moves(rhs.moves), value(rhs.value) {
+      ++*live;
+      ++*moves;
+    }
+    tracked& operator =(const tracked&) = delete;
+    ~tracked() { --*live; }
+
+    int* live;
+    int* moves;
+    int value;
+  };
+
+  SECTION("Only elements are constructed, each once") {
+    int live = 0, moves = 0;
+    {
+      dr::gap_buffer<tracked> gb(0);
+      gb.reserve(64);
+      for (int i = 0; i < 10; ++i) gb.emplace_back(&live, &moves, i);
+      CHECK(live == 10);
+      CHECK(moves == 0);
+
+      // the gap passes the 7 elements behind the new one
+      gb.emplace(gb.begin() + 3, &live, &moves, 42);
+      CHECK(live == 11);
+      CHECK(moves == 7);
+      CHECK(gb[3].value == 42);
+
+      gb.erase(gb.begin(), gb.begin() + 2);
+      CHECK(live == 9);
+
+      // an argument from the buffer itself survives the gap move
+      gb.insert(gb.begin() + 5, gb[0]);
+      CHECK(gb[5].value == 2);
+      gb.push_back(gb[1]);
+      CHECK(gb.back().value == 42);
+      CHECK(live == 11);
+
+      gb.reserve(1000);
+      CHECK(live == 11);
+    }
+    CHECK(live == 0);
+  }
+
+  SECTION("Random edits of strings agree with a vector") {
+    dr::gap_buffer<std::string> gb(0);
+    std::vector<std::string> v;
+    std::mt19937 rng(8);
+    for (int i = 0; i < 3000; ++i) {
+      // long enough to live on the heap, so that leaks show
+      std::string s(40, char('a' + i % 26));
+      std::size_t pos = rng() % (v.size() + 1);
+      switch (rng() % 4) {
+      case 0:
+        gb.emplace(gb.begin() + pos, s);
+        v.emplace(v.begin() + pos, s);
+        break;
+      case 1:
+        gb.insert(gb.begin() + pos, 3, s);
+        v.insert(v.begin() + pos, 3, s);
+        break;
+      case 2: {
+        std::size_t n = std::min<std::size_t>(rng() % 5, v.size() - pos);
+        gb.erase(gb.begin() + pos, gb.begin() + pos + n);
+        v.erase(v.begin() + pos, v.begin() + pos + n);
+        break;
+      }
+      default:
+        if (i % 100 == 0) gb.shrink_to_fit();
+        gb.push_back(std::move(s));
+        v.push_back(std::string(40, char('a' + i % 26)));
+      }
+    }
+    CHECK(std::equal(gb.begin(), gb.end(), v.begin(), v.end()));
+  }
+
+  SECTION("Inline storage") {
+    int live = 0, moves = 0;
+    {
+      dr::small_gap_buffer<tracked, 4> gb1;
+      gb1.emplace_back(&live, &moves, 1);
+      gb1.emplace(gb1.begin(), &live, &moves, 0);
+      dr::small_gap_buffer<tracked, 4> gb2(std::move(gb1));
+      CHECK(live == 2);
+      CHECK(gb2[0].value == 0);
+      CHECK(gb2[1].value == 1);
+      for (int i = 2; i < 6; ++i) gb2.emplace_back(&live, &moves, i);
+      gb2.swap(gb1);
+      CHECK(gb1.size() == 6);
+      CHECK(live == 6);
+    }
+    CHECK(live == 0);
+  }
+}
+
+TEST_CASE("Gapbuffer fills in bulk", "[gapbuffer]") {
+
+  SECTION("Fill constructor, insert, resize and assign") {
+    dr::gap_buffer<char> gb1(5, 'x');
+    CHECK(std::string(gb1.begin(), gb1.end()) == "xxxxx");
+
+    auto it = gb1.insert(gb1.begin() + 2, 3, '-');
+    CHECK(it == gb1.begin() + 2);
+    CHECK(std::string(gb1.begin(), gb1.end()) == "xx---xxx");
+#ifdef DR_GAP_BUFFER_STATS
+    CHECK(gb1.stats().reallocations <= 1);
+#endif
+
+    gb1.resize(12, ' ');
+    CHECK(std::string(gb1.begin(), gb1.end()) == "xx---xxx    ");
+    gb1.resize(3);
+    CHECK(std::string(gb1.begin(), gb1.end()) == "xx-");
+
+    auto capacity = gb1.capacity();
+    gb1.assign(4, 'a');
+    CHECK(std::string(gb1.begin(), gb1.end()) == "aaaa");
+    CHECK(gb1.capacity() == capacity);
+  }
+
+  SECTION("A million elements in one pass") {
+    dr::gap_buffer<char> gb1{'a', 'b'};
+#ifdef DR_GAP_BUFFER_STATS
+    gb1.reset_stats();
+#endif
+    gb1.insert(gb1.begin() + 1, 1'000'000, ' ');
+    CHECK(gb1.size() == 1'000'002);
+#ifdef DR_GAP_BUFFER_STATS
+    CHECK(gb1.stats().reallocations == 1);
+#endif
+    CHECK(dr::count(gb1.begin(), gb1.end(), ' ') == 1'000'000);
+    CHECK(gb1.back() == 'b');
+  }
+
+  SECTION("Elements of the buffer as the value") {
+    dr::gap_buffer<std::string> gb1(3, std::string(30, 's'));
+    gb1.insert(gb1.begin(), 100, gb1[2]);
+    CHECK(gb1.size() == 103);
+    CHECK(std::all_of(gb1.begin(), gb1.end(), [](const std::string& s) { return s == std::string(30, 's'); }));
+
+    gb1.assign(2, gb1[1]);
+    CHECK(gb1.size() == 2);
+    CHECK(gb1[1] == std::string(30, 's'));
+  }
+}
+
+#ifdef DR_GAP_BUFFER_STATS
+TEST_CASE("Gapbuffer storage stats", "[gapbuffer]") {
+  struct recorder : dr::gap_buffer_trace_sink {
+    void gap_moved(const void*, std::size_t from, std::size_t to) override { moves.emplace_back(from, to); }
+    void reallocated(const void*, std::size_t, std::size_t, std::size_t bytes) override { copied += bytes; }
+
+    std::vector<std::pair<std::size_t, std::size_t>> moves;
+    std::size_t copied = 0;
+  };
+
+  dr::gap_buffer<char> gb(0);
+  recorder r;
+  auto previous = dr::set_trace_sink(&r);
+
+  std::string s(100, 'x');
+  gb.insert(gb.end(), s.begin(), s.end());
+  CHECK(gb.stats().reallocations == 1);
+  CHECK(gb.stats().bytes_copied == 0);
+
+  gb.insert(gb.begin(), 'a');
+  gb.insert(gb.end(), 'b');
+  CHECK(gb.stats().elements_moved == 200);
+  CHECK(r.moves == std::vector<std::pair<std::size_t, std::size_t>>{{100, 0}, {1, 101}});
+  CHECK(gb.stats().average_gap_distance() == Approx(200.0 / gb.stats().gap_relocations));
+
+  gb.reserve(4 * gb.capacity());
+  CHECK(gb.stats().reallocations == 2);
+  CHECK(gb.stats().bytes_copied == 102);
+  CHECK(r.copied == 102);
+  CHECK(gb.stats().peak_capacity == gb.capacity());
+
+  dr::set_trace_sink(previous);
+  gb.shrink_to_fit();
+  gb.reset_stats();
+  CHECK(gb.stats().gap_relocations == 0);
+  CHECK(gb.stats().peak_capacity == gb.capacity());
+  gb.insert(gb.begin(), 'c');
+  CHECK(gb.stats().elements_moved == 102);
+  CHECK(r.moves.size() == 2);
+}
+#else
+TEST_CASE("Gapbuffer carries no stats by default", "[gapbuffer]") {
+  // start, finish, gap start, gap size and the listener list, with the
+  // empty std::allocator padded to a word
+  CHECK(sizeof(dr::gap_buffer<char>) <= 6 * sizeof(void*));
+}
+#endif
+
+TEST_CASE("Byte kernels agree with the standard algorithms", "[simd]") {
+  using dr::simd::byte;
+
+  std::mt19937 rng(11);
+  std::vector<byte> data(3000);
+  for (auto& b : data) b = byte("abcd\n"[rng() % 5]);
+  const byte* first = data.data();
+
+  for (auto level : {dr::simd::isa::scalar, dr::simd::isa::sse2, dr::simd::isa::avx2}) {
+    const auto& k = dr::simd::kernels(level);
+    for (int round = 0; round < 200; ++round) {
+      std::size_t lo = rng() % 100, hi = lo + rng() % (data.size() - lo);
+      const byte* f = first + lo;
+      const byte* l = first + hi;
+
+      CHECK(k.find(f, l, byte('\n')) == std::find(f, l, byte('\n')));
+      CHECK(k.find(f, l, byte('z')) == l);
+      CHECK(k.count(f, l, byte('\n')) == std::size_t(std::count(f, l, byte('\n'))));
+
+      const byte set[] = {'z', '\n', 'd'};
+      std::size_t set_size = 1 + rng() % 3;
+      CHECK(k.find_first_of(f, l, set, set_size) == std::find_first_of(f, l, set, set + set_size));
+
+      std::size_t m = rng() % 6;
+      std::size_t at = rng() % data.size();
+      const byte* needle = first + std::min(at, data.size() - m);
+      CHECK(k.search(f, l, needle, m) == std::search(f, l, needle, needle + m));
+    }
+  }
+}
+
+TEST_CASE("Gapbuffer searches across the gap", "[gapbuffer][simd]") {
+  std::string text = "the quick brown fox\njumps over\nthe lazy dog\n";
+
+  for (std::size_t gap = 0; gap <= text.size(); ++gap) {
+    dr::gap_buffer<char> gb1(text.begin(), text.end());
+    gb1.insert(gb1.begin() + gap, 'x');
+    gb1.erase(gb1.begin() + gap);
+    REQUIRE(std::string(gb1.begin(), gb1.end()) == text);
+
+    CHECK(dr::count(gb1.begin(), gb1.end(), '\n') == 3);
+    CHECK(dr::find(gb1.begin(), gb1.end(), 'j') - gb1.begin() == 20);
+
+    std::string set = "yz";
+    CHECK(dr::find_first_of(gb1.begin(), gb1.end(), set.begin(), set.end()) - gb1.begin() == 37);
+
+    for (const char* needle : {"fox\njumps", "over\nthe", "dog\n", "the", "cat", ""}) {
+      std::string s = needle;
+      auto expected = std::search(text.begin(), text.end(), s.begin(), s.end()) - text.begin();
+      CHECK(dr::search(gb1.begin(), gb1.end(), s.begin(), s.end()) - gb1.begin() == expected);
+      CHECK(dr::search(gb1.cbegin(), gb1.cend(), s.data(), s.data() + s.size()) - gb1.cbegin() == expected);
+    }
+  }
+
+  dr::gap_buffer<int> gb2{1, 2, 3, 4, 5};
+  gb2.insert(gb2.begin() + 2, 9);
+  std::vector<int> needle{2, 9, 3};
+  CHECK(dr::search(gb2.begin(), gb2.end(), needle.begin(), needle.end()) - gb2.begin() == 1);
+  CHECK(dr::count(gb2.begin(), gb2.end(), 9) == 1);
+}
+
+TEST_CASE("Searchers match across the gap", "[gapbuffer][search]") {
+  std::mt19937 rng(11);
+  std::string text;
+  for (int i = 0; i < 600; ++i) text.push_back("abc\n"[rng() % 4]);
+
+  SECTION("Single patterns against std::search") {
+    for (std::size_t gap : {std::size_t(0), std::size_t(1), std::size_t(299), text.size() - 1, text.size()}) {
+      dr::gap_buffer<char> gb(text.begin(), text.end());
+      gb.insert(gb.begin() + std::ptrdiff_t(gap), 'x');
+      gb.erase(gb.begin() + std::ptrdiff_t(gap));
+
+      for (std::size_t start = gap >= 6 ? gap - 6 : 0; start <= std::min(gap, text.size() - 7); ++start) {
+        std::string needle = text.substr(start, 7);
+        dr::pattern_searcher<char> searcher(needle.begin(), needle.end());
+        auto expected = std::search(text.begin(), text.end(), needle.begin(), needle.end()) - text.begin();
+        auto[first, last] = searcher(gb.begin(), gb.end());
+        REQUIRE(first - gb.begin() == expected);
+        CHECK(last - first == 7);
+        CHECK(dr::search(gb.cbegin(), gb.cend(), searcher) - gb.cbegin() == expected);
+
+        // a predicate of its own takes the Horspool path for bytes too
+        struct fold_hash {
+          std::size_t operator ()(char c) const { return std::size_t(std::toupper(c)); }
+        };
+        struct fold_equal {
+          bool operator ()(char a, char b) const { return std::toupper(a) == std::toupper(b); }
+        };
+        std::string upper = needle;
+        for (char& c : upper) c = char(std::toupper(c));
+        dr::pattern_searcher<char, fold_hash, fold_equal> folded(upper.begin(), upper.end());
+        CHECK(folded(gb.begin(), gb.end()).first - gb.begin() == expected);
+      }
+    }
+
+    dr::gap_buffer<int> gb2{1, 2, 3, 4, 5, 2, 9};
+    gb2.insert(gb2.begin() + 2, 9);
+    std::vector<int> needle{2, 9};
+    dr::pattern_searcher searcher(needle.begin(), needle.end());
+    auto m = searcher(gb2.begin(), gb2.end());
+    CHECK(m.first - gb2.begin() == 1);
+    m = searcher(m.second, gb2.end());
+    CHECK(m.first - gb2.begin() == 6);
+    CHECK(searcher(m.second, gb2.end()).first == gb2.end());
+  }
+
+  SECTION("Replace-all loop resumes from offsets") {
+    dr::gap_buffer<char> gb(text.begin(), text.end());
+    gb.insert(gb.begin() + 100, 'x');
+    gb.erase(gb.begin() + 100);
+
+    std::string from = "ab", to = "xyz";
+    dr::pattern_searcher<char> searcher(from.begin(), from.end());
+    std::size_t offset = 0;
+    for (auto m = searcher(gb.begin(), gb.end()); m.first != gb.end();
+         m = searcher(gb.begin() + std::ptrdiff_t(offset), gb.end())) {
+      offset = std::size_t(m.first - gb.begin());
+      gb.replace(m.first, m.second, to.begin(), to.end());
+      offset += to.size();
+    }
+
+    std::string expected = text;
+    for (std::size_t p = 0; (p = expected.find(from, p)) != std::string::npos; p += to.size())
+      expected.replace(p, from.size(), to);
+    CHECK(std::string(gb.begin(), gb.end()) == expected);
+  }
+
+  SECTION("Keywords against brute force") {
+    // few bytes start a keyword of the first set, more than the vector
+    // kernels take of the second
+    std::vector<std::string> second;
+    for (char c = 'd'; c <= 'z'; ++c) second.push_back(std::string(1, c) + "a");
+    second.push_back("ab\nc");
+    second.push_back("\na");
+
+    for (const auto& keywords : {std::vector<std::string>{"abc", "bc", "c\na", "cab", "aaaa", "b"}, second}) {
+      dr::keyword_searcher<char> searcher(keywords);
+      CHECK(searcher.keyword_count() == keywords.size());
+
+      for (std::size_t gap : {std::size_t(0), std::size_t(2), std::size_t(301), text.size()}) {
+        dr::gap_buffer<char> gb(text.begin(), text.end());
+        gb.insert(gb.begin() + std::ptrdiff_t(gap), 'x');
+        gb.erase(gb.begin() + std::ptrdiff_t(gap));
+
+        std::vector<std::tuple<std::size_t, std::size_t, std::size_t>> found, expected;
+        searcher.for_each_match(gb.begin(), gb.end(), [&](const auto& m) {
+          found.emplace_back(m.offset + m.length, std::size_t(0) - m.length, m.keyword);
+          return true;
+        });
+        for (std::size_t k = 0; k < keywords.size(); ++k)
+          for (std::size_t p = 0; (p = text.find(keywords[k], p)) != std::string::npos; ++p)
+            expected.emplace_back(p + keywords[k].size(), std::size_t(0) - keywords[k].size(), k);
+        std::sort(expected.begin(), expected.end());
+        REQUIRE(found == expected);
+
+        auto[first, last] = searcher(gb.begin(), gb.end());
+        CHECK(std::size_t(first - gb.begin()) == std::get<0>(expected[0]) + std::get<1>(expected[0]));
+        CHECK(std::string(first, last) == keywords[std::get<2>(expected[0])]);
+      }
+    }
+
+    dr::keyword_searcher<char> none{"zz", "q"};
+    dr::gap_buffer<char> gb(text.begin(), text.end());
+    CHECK(none(gb.begin(), gb.end()).first == gb.end());
+  }
+
+}
+
+TEST_CASE("Gapbuffer grows around the insertion point", "[gapbuffer]") {
+
+  SECTION("Growing insert far from the gap") {
+    dr::gap_buffer<char> gb1{'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h'};
+    gb1.insert(gb1.begin() + 6, 'x');
+    std::string s(20, 'y');
+    gb1.insert(gb1.begin() + 1, s.begin(), s.end());
+    CHECK(gb1.size() == 29);
+    CHECK(std::string(gb1.begin(), gb1.end()) == "a" + s + "bcdefxgh");
+  }
+
+  SECTION("Growing with a non-trivial element type") {
+    dr::gap_buffer<std::string> gb1{"a", "b", "c"};
+    gb1.insert(gb1.begin() + 1, "x");
+    for (int i = 0; i < 20; ++i) gb1.insert(gb1.begin() + 2, std::to_string(i));
+    CHECK(gb1.size() == 24);
+    CHECK(gb1[0] == "a");
+    CHECK(gb1[1] == "x");
+    CHECK(gb1[2] == "19");
+    CHECK(gb1[21] == "0");
+    CHECK(gb1[22] == "b");
+    CHECK(gb1[23] == "c");
+  }
+
+  SECTION("Reserve keeps the contents") {
+    dr::gap_buffer<char> gb1{'a', 'b', 'c', 'd'};
+    gb1.insert(gb1.begin() + 2, 'x');
+    gb1.reserve(100);
+    CHECK(gb1.capacity() >= 100);
+    CHECK(std::string(gb1.begin(), gb1.end()) == "abxcd");
+  }
+
+}
+
+TEST_CASE("Gapbuffer follows its growth policy", "[gapbuffer]") {
+
+  SECTION("Default policy") {
+    dr::gap_buffer<char> gb1;
+    CHECK(gb1.capacity() == 8);
+    gb1.reserve(13);
+    CHECK(gb1.capacity() == 16);
+  }
+
+  SECTION("Geometric policy doubles and shrinks") {
+    dr::gap_buffer<char, std::allocator<char>, dr::geometric_growth_policy<char>> gb1;
+    CHECK(gb1.capacity() == 64);
+    std::string s(65, 'a');
+    gb1.insert(gb1.end(), s.begin(), s.end());
+    CHECK(gb1.capacity() == 128);
+
+    std::string t(1000, 'b');
+    gb1.insert(gb1.end(), t.begin(), t.end());
+    CHECK(gb1.capacity() >= 1065);
+    gb1.erase(gb1.begin() + 10, gb1.end());
+    CHECK(gb1.size() == 10);
+    CHECK(gb1.capacity() == 64);
+    CHECK(std::string(gb1.begin(), gb1.end()) == std::string(10, 'a'));
+  }
+
+  SECTION("Page policy keeps a minimum gap") {
+    dr::gap_buffer<char, std::allocator<char>, dr::page_growth_policy<char>> gb1;
+    CHECK(gb1.capacity() == 4096);
+    std::string s(5000, 'a');
+    gb1.insert(gb1.end(), s.begin(), s.end());
+    CHECK(gb1.capacity() % 4096 == 0);
+    CHECK(gb1.capacity() - gb1.size() >= 4096);
+  }
+
+}
+
+namespace {
+
+/// \brief mmap_allocator which remembers the largest range offered to discard
+struct discard_recorder : dr::mmap_allocator<char> {
+  void discard(char* p, std::size_t n) noexcept {
+    largest = std::max(largest, n);
+    dr::mmap_allocator<char>::discard(p, n);
+  }
+
+  static inline std::size_t largest = 0;
+};
+
+}
+
+TEST_CASE("Gapbuffer on mapped memory", "[gapbuffer]") {
+  using mapped_buffer = dr::gap_buffer<char, dr::mmap_allocator<char>, dr::page_growth_policy<char>>;
+
+  SECTION("Growing in place keeps the contents around the new gap") {
+    std::string s(10000, 'a');
+    for (std::size_t i = 0; i < s.size(); ++i) s[i] = char('a' + i % 26);
+
+    mapped_buffer gb1(s.begin(), s.end());
+    gb1.insert(gb1.begin() + 7000, 'x');
+    s.insert(s.begin() + 7000, 'x');
+
+    std::string t(20000, 'y');
+    gb1.insert(gb1.begin() + 3000, t.begin(), t.end());
+    s.insert(s.begin() + 3000, t.begin(), t.end());
+    CHECK(std::string(gb1.begin(), gb1.end()) == s);
+
+    gb1.insert(gb1.begin() + 25000, t.begin(), t.end());
+    s.insert(s.begin() + 25000, t.begin(), t.end());
+    CHECK(std::string(gb1.begin(), gb1.end()) == s);
+  }
+
+  SECTION("Erased pages are released") {
+    std::string s(std::size_t(4) << 20, 'a');
+    mapped_buffer gb1(s.begin(), s.end());
+    gb1.erase(gb1.begin() + 10, gb1.end() - 10);
+    CHECK(gb1.size() == 20);
+    gb1.insert(gb1.begin() + 10, s.begin(), s.end());
+    CHECK(gb1.size() == s.size() + 20);
+    CHECK(gb1[s.size() + 15] == 'a');
+  }
+
+  SECTION("Pages freed by many small erases are released") {
+    using recording_buffer = dr::gap_buffer<char, discard_recorder, dr::page_growth_policy<char>>;
+    std::string s(std::size_t(4) << 20, 'a');
+    recording_buffer gb1(s.begin(), s.end());
+    discard_recorder::largest = 0;
+    for (std::size_t i = 0; i < (std::size_t(3) << 19); ++i) gb1.erase(gb1.end() - 1);
+    CHECK(discard_recorder::largest >= dr::mmap_allocator<char>::discard_threshold);
+    CHECK(gb1.size() == s.size() - (std::size_t(3) << 19));
+    gb1.insert(gb1.end(), 'b');
+    CHECK(gb1.back() == 'b');
+  }
+
+}
+
+namespace {
+
+/// \brief allocator with an identity which follows its buffer on copy,
+/// move and swap
+template<typename T>
+struct tagged_allocator {
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  explicit tagged_allocator(int tag = 0) : tag(tag) { }
+
+  template<typename U>
+  tagged_allocator(const tagged_allocator<U>& rhs) : tag(rhs.tag) { }
+
+  T* allocate(std::size_t n) { return std::allocator<T>().allocate(n); }
+  void deallocate(T* p, std::size_t n) { std::allocator<T>().deallocate(p, n); }
+
+  friend bool operator ==(const tagged_allocator& lhs, const tagged_allocator& rhs) { return lhs.tag == rhs.tag; }
+  friend bool operator !=(const tagged_allocator& lhs, const tagged_allocator& rhs) { return lhs.tag != rhs.tag; }
+
+  int tag;
+};
+
+}
+
+TEST_CASE("Gapbuffer allocators", "[gapbuffer]") {
+  std::string s(1000, 'a');
+  for (std::size_t i = 0; i < s.size(); ++i) s[i] = char('a' + i % 26);
+
+  SECTION("Propagating allocators follow the contents") {
+    using tagged_buffer = dr::gap_buffer<char, tagged_allocator<char>>;
+    tagged_buffer gb1(s.begin(), s.end(), tagged_allocator<char>(1));
+    tagged_buffer gb2({'x', 'y'}, tagged_allocator<char>(2));
+
+    gb1.swap(gb2);
+    CHECK(gb1.get_allocator().tag == 2);
+    CHECK(gb2.get_allocator().tag == 1);
+    CHECK(std::string(gb2.begin(), gb2.end()) == s);
+
+    gb1 = gb2;
+    CHECK(gb1.get_allocator().tag == 1);
+    CHECK(gb1 == gb2);
+
+    tagged_buffer gb3(tagged_allocator<char>(3));
+    gb3 = std::move(gb1);
+    CHECK(gb3.get_allocator().tag == 1);
+    CHECK(std::string(gb3.begin(), gb3.end()) == s);
+
+    tagged_buffer gb4(gb3, tagged_allocator<char>(4));
+    CHECK(gb4.get_allocator().tag == 4);
+    CHECK(gb4 == gb3);
+  }
+
+  SECTION("Buffers on a memory resource keep it") {
+    dr::pmr::gap_buffer_arena arena1;
+    dr::pmr::gap_buffer_arena arena2;
+    dr::pmr::gap_buffer<char> gb1(s.begin(), s.end(), &arena1);
+    dr::pmr::gap_buffer<char> gb2(&arena2);
+    CHECK(gb1.get_allocator().resource() == &arena1);
+    CHECK(arena1.reserved() > 0);
+
+    for (std::size_t i = 0; i < 5000; ++i) gb2.insert(gb2.begin() + std::ptrdiff_t(i / 2), char('0' + i % 10));
+    CHECK(gb2.size() == 5000);
+
+    gb2 = gb1;
+    CHECK(gb2.get_allocator().resource() == &arena2);
+    CHECK(gb2 == gb1);
+
+    dr::pmr::gap_buffer<char> gb3(std::move(gb1));
+    CHECK(gb3.get_allocator().resource() == &arena1);
+    CHECK(gb1.empty());
+
+    gb2.insert(gb2.begin() + 10, 'x');
+    gb3 = std::move(gb2);
+    CHECK(gb3.get_allocator().resource() == &arena1);
+    CHECK(gb3[10] == 'x');
+    CHECK(gb3.size() == s.size() + 1);
+
+    dr::pmr::gap_buffer<char> gb4(std::move(gb3), &arena2);
+    CHECK(gb4.get_allocator().resource() == &arena2);
+    CHECK(gb4.size() == s.size() + 1);
+
+    dr::pmr::gap_buffer<char> gb5(gb4);
+    CHECK(gb5.get_allocator().resource() == std::pmr::get_default_resource());
+    CHECK(gb4.substr(gb4.cbegin(), gb4.cend()) == gb5);
+    CHECK(dr::parallel::substr(gb4, gb4.cbegin(), gb4.cend()) == gb5);
+
+    dr::pmr::gap_buffer<std::pmr::string> strings(&arena1);
+    for (int i = 0; i < 100; ++i) strings.insert(strings.begin(), std::pmr::string(40, char('a' + i % 26)));
+    CHECK(strings.size() == 100);
+    CHECK(strings.back() == std::pmr::string(40, 'a'));
+  }
+
+  SECTION("Arena size classes") {
+    using arena = dr::pmr::gap_buffer_arena;
+    CHECK(arena::block_size(1) == 64);
+    CHECK(arena::block_size(64) == 64);
+    CHECK(arena::block_size(65) == 80);
+    CHECK(arena::block_size(128) == 128);
+    CHECK(arena::block_size(129) == 160);
+    CHECK(arena::block_size(1000) == 1024);
+    CHECK(arena::block_size(arena::max_block) == arena::max_block);
+
+    arena a(std::pmr::get_default_resource(), 1024);
+    void* p = a.allocate(100);
+    void* q = a.allocate(100);
+    CHECK(p != q);
+    a.deallocate(p, 100);
+    CHECK(a.allocate(110) == p);
+
+    void* big = a.allocate(arena::max_block + 1);
+    a.deallocate(big, arena::max_block + 1);
+    void* aligned = a.allocate(64, 64);
+    CHECK(reinterpret_cast<std::uintptr_t>(aligned) % 64 == 0);
+    a.deallocate(aligned, 64, 64);
+
+    for (int i = 0; i < 100; ++i) CHECK(reinterpret_cast<std::uintptr_t>(a.allocate(48 + 16 * std::size_t(i))) % 16 == 0);
+    a.release();
+    CHECK(a.reserved() == 0);
+  }
+
+}
+
+TEST_CASE("Gapbuffer file I/O", "[gapbuffer]") {
+  char path[] = "/tmp/gapbuffer_testXXXXXX";
+  int fd = mkstemp(path);
+  REQUIRE(fd >= 0);
+
+  std::string s(100000, 'a');
+  for (std::size_t i = 0; i < s.size(); ++i) s[i] = char('a' + i % 26);
+  REQUIRE(write(fd, s.data(), s.size()) == ssize_t(s.size()));
+
+  SECTION("Load and save through the gap") {
+    lseek(fd, 0, SEEK_SET);
+    dr::gap_buffer<char> gb1{'<', '>'};
+#ifdef DR_GAP_BUFFER_STATS
+    gb1.reset_stats();
+#endif
+    CHECK(dr::load_from_fd(fd, gb1, gb1.begin() + 1) == s.size());
+#ifdef DR_GAP_BUFFER_STATS
+    CHECK(gb1.stats().reallocations == 1);
+#endif
+    CHECK(gb1.size() == s.size() + 2);
+    CHECK(std::string(gb1.begin() + 1, gb1.end() - 1) == s);
+
+    gb1.insert(gb1.begin() + 500, 'x');
+    ftruncate(fd, 0);
+    lseek(fd, 0, SEEK_SET);
+    dr::save_to_fd(fd, gb1);
+
+    lseek(fd, 0, SEEK_SET);
+    dr::gap_buffer<char> gb2(0);
+    dr::load_from_fd(fd, gb2);
+    CHECK(gb2 == gb1);
+  }
+
+  SECTION("Mapped buffer copies on first edit") {
+    dr::mapped_buffer mb(fd);
+    CHECK(!mb.materialized());
+    CHECK(mb.size() == s.size());
+    CHECK(mb[27] == 'b');
+    CHECK(mb.segments().first.size() == s.size());
+
+    mb.edit().insert(mb.edit().begin(), 'x');
+    CHECK(mb.materialized());
+    CHECK(mb.size() == s.size() + 1);
+    CHECK(mb[0] == 'x');
+    CHECK(mb[28] == 'b');
+  }
+
+  close(fd);
+  unlink(path);
+}
+
+TEST_CASE("Gapbuffer applies batches of edits", "[gapbuffer]") {
+  using edit = dr::gap_buffer<char>::edit;
+  std::string foo("foo"), x("x");
+
+  SECTION("In place") {
+    std::string s("a.b.c.d.e.f.g.h.i.j.k.l.m.n");
+    dr::gap_buffer<char> gb1(s.begin(), s.end());
+    gb1.reserve(100);
+    std::vector<edit> edits{{1, 1, foo}, {3, 1, {}}, {5, 0, x}, {26, 1, x}};
+    gb1.apply_edits(edits);
+    CHECK(std::string(gb1.begin(), gb1.end()) == "afoobcx.d.e.f.g.h.i.j.k.l.m.x");
+  }
+
+  SECTION("Into a new allocation") {
+    std::vector<std::string> gb1{"a", "b", "c", "d"};
+    dr::gap_buffer<std::string> gb2(gb1.begin(), gb1.end());
+    std::vector<std::string> text(10, "z");
+    std::vector<dr::gap_buffer<std::string>::edit> edits{{0, 0, text}, {2, 1, text}, {4, 0, text}};
+    gb2.apply_edits(edits);
+    CHECK(gb2.size() == 33);
+    CHECK(gb2[9] == "z");
+    CHECK(gb2[10] == "a");
+    CHECK(gb2[11] == "b");
+    CHECK(gb2[12] == "z");
+    CHECK(gb2[22] == "d");
+    CHECK(gb2[32] == "z");
+
+    std::string s(1000, '.');
+    dr::gap_buffer<char> gb3(s.begin(), s.end());
+    std::vector<edit> more;
+    for (std::size_t i = 0; i < 1000; i += 10) more.push_back({i, 1, foo});
+    gb3.apply_edits(more);
+    CHECK(gb3.size() == 1200);
+    CHECK(dr::count(gb3.begin(), gb3.end(), 'f') == 100);
+    CHECK(gb3[1190] == 'o');
+    CHECK(gb3[1191] == '.');
+  }
+
+  SECTION("Listeners see each edit on the contents it applies to") {
+    using buffer = dr::gap_buffer<char>;
+    // replays the notifications on a copy, which must match the buffer
+    // whenever the buffer calls it
+    struct shadow : buffer::edit_listener {
+      std::string text;
+      bool in_sync = true;
+
+      void inserted(const buffer& gb, std::size_t offset, std::size_t count) override {
+        text.insert(offset, std::string(gb.begin() + offset, gb.begin() + offset + count));
+        in_sync = in_sync && text == std::string(gb.begin(), gb.end());
+      }
+
+      void erasing(const buffer& gb, std::size_t offset, std::size_t count) override {
+        in_sync = in_sync && text == std::string(gb.begin(), gb.end());
+        text.erase(offset, count);
+      }
+    };
+
+    std::mt19937 rng(9);
+    std::string texts[] = {"", "x", "foo", "a much longer replacement text"};
+    for (int round = 0; round < 100; ++round) {
+      std::string s(rng() % 60 + 1, '.');
+      for (auto& c : s) c = char('a' + rng() % 26);
+      std::vector<edit> edits;
+      for (std::size_t pos = rng() % 5; pos < s.size(); pos += 1 + rng() % 8) {
+        std::size_t n = std::min<std::size_t>(rng() % 4, s.size() - pos);
+        edits.push_back({pos, n, texts[rng() % 4]});
+        pos += n;
+      }
+
+      // with room for the batch or without, and the gap anywhere
+      buffer gb1(s.begin(), s.end());
+      if (round % 2) gb1.reserve(s.size() + 1000);
+      std::size_t gap = rng() % (s.size() + 1);
+      gb1.insert(gb1.begin() + gap, 'k');
+      gb1.erase(gb1.begin() + gap);
+
+      shadow sh;
+      sh.text = s;
+      gb1.attach(sh);
+      gb1.apply_edits(edits);
+      gb1.detach(sh);
+      CHECK(sh.in_sync);
+      CHECK(sh.text == std::string(gb1.begin(), gb1.end()));
+    }
+  }
+
+  SECTION("In place from either side of the gap") {
+    std::mt19937 rng(8);
+    std::string texts[] = {"", "x", "foo", "longer text"};
+    for (int round = 0; round < 200; ++round) {
+      std::string s(rng() % 60 + 1, '.');
+      for (auto& c : s) c = char('a' + rng() % 26);
+
+      std::vector<edit> edits;
+      for (std::size_t pos = rng() % 5; pos < s.size(); pos += 1 + rng() % 8) {
+        std::size_t n = std::min<std::size_t>(rng() % 4, s.size() - pos);
+        edits.push_back({pos, n, texts[rng() % 4]});
+        pos += n;
+      }
+      std::string expected = s;
+      for (std::size_t i = edits.size(); i-- > 0;)
+        expected.replace(edits[i].offset, edits[i].erase_count, edits[i].text.data(), edits[i].text.size());
+
+      std::size_t gap = rng() % (s.size() + 1);
+      dr::gap_buffer<char> gb1(s.begin(), s.end());
+      gb1.reserve(s.size() + 200);
+      gb1.insert(gb1.begin() + gap, 'k');
+      gb1.erase(gb1.begin() + gap);
+      gb1.apply_edits(edits);
+      CHECK(std::string(gb1.begin(), gb1.end()) == expected);
+
+      std::vector<std::string> words;
+      for (char c : s) words.emplace_back(1, c);
+      dr::gap_buffer<std::string> gb2(words.begin(), words.end());
+      gb2.reserve(s.size() + 200);
+      gb2.insert(gb2.begin() + gap, "k");
+      gb2.erase(gb2.begin() + gap);
+      std::vector<std::vector<std::string>> word_texts;
+      for (const edit& e : edits) word_texts.emplace_back(e.text.size(), "z");
+      std::vector<dr::gap_buffer<std::string>::edit> word_edits;
+      for (std::size_t i = 0; i < edits.size(); ++i)
+        word_edits.push_back({edits[i].offset, edits[i].erase_count, word_texts[i]});
+      gb2.apply_edits(word_edits);
+      std::string joined;
+      for (const auto& w : gb2) joined += w;
+      std::string masked = s;
+      for (std::size_t i = edits.size(); i-- > 0;)
+        masked.replace(edits[i].offset, edits[i].erase_count, std::string(edits[i].text.size(), 'z'));
+      CHECK(joined == masked);
+    }
+  }
+
+  SECTION("Shrinking batches stay in place") {
+    std::string s(1000, '.');
+    for (std::size_t i = 0; i < s.size(); ++i) s[i] = char('a' + i % 26);
+    dr::gap_buffer<char> gb1(s.begin(), s.end());
+    gb1.reserve(4000);
+    auto capacity = gb1.capacity();
+#ifdef DR_GAP_BUFFER_STATS
+    gb1.reset_stats();
+#endif
+
+    std::vector<edit> deletes{{10, 5, {}}};
+    gb1.apply_edits(deletes);
+    s.erase(10, 5);
+    CHECK(std::string(gb1.begin(), gb1.end()) == s);
+
+    gb1.insert(gb1.end(), '!');
+    gb1.erase(gb1.end() - 1);
+    std::vector<edit> shrinking{{100, 3, x}, {200, 10, foo}, {600, 0, foo}, {900, 50, {}}};
+    gb1.apply_edits(shrinking);
+    s.erase(900, 50);
+    s.insert(600, foo);
+    s.replace(200, 10, foo);
+    s.replace(100, 3, x);
+    CHECK(std::string(gb1.begin(), gb1.end()) == s);
+
+    CHECK(gb1.capacity() == capacity);
+#ifdef DR_GAP_BUFFER_STATS
+    CHECK(gb1.stats().reallocations == 0);
+#endif
+  }
+}
+
+TEST_CASE("Line index follows edits", "[line_index]") {
+  using buffer = dr::gap_buffer<char>;
+
+  auto check = [](const dr::line_index<buffer>& index, const std::string& s) {
+    std::vector<std::size_t> starts{0};
+    for (std::size_t i = 0; i < s.size(); ++i)
+      if (s[i] == '\n') starts.push_back(i + 1);
+    REQUIRE(index.line_count() == starts.size());
+    for (std::size_t line = 0; line < starts.size(); ++line)
+      CHECK(index.line_to_offset(line) == starts[line]);
+    for (std::size_t offset = 0; offset <= s.size(); ++offset)
+      CHECK(index.offset_to_line(offset)
+            == std::size_t(std::upper_bound(starts.begin(), starts.end(), offset) - starts.begin() - 1));
+  };
+
+  SECTION("Random edits") {
+    std::string s = "one\ntwo\n\nthree\n";
+    buffer gb1(s.begin(), s.end());
+    dr::line_index<buffer> index(gb1, 8);
+    check(index, s);
+
+    std::mt19937 rng(12);
+    for (int round = 0; round < 300; ++round) {
+      std::size_t pos = rng() % (s.size() + 1);
+      if (rng() % 3 == 0 && pos < s.size()) {
+        std::size_t n = std::min<std::size_t>(rng() % 20, s.size() - pos);
+        gb1.erase(gb1.begin() + pos, gb1.begin() + pos + n);
+        s.erase(pos, n);
+      }
+      else {
+        std::string text;
+        for (std::size_t n = rng() % 24; n > 0; --n) text.push_back("ab\n"[rng() % 3]);
+        gb1.insert(gb1.begin() + pos, text.begin(), text.end());
+        s.insert(pos, text);
+      }
+      check(index, s);
+    }
+  }
+
+  SECTION("Replace, batches and reset") {
+    std::string s = "a\nb\nc\nd\n";
+    buffer gb1(s.begin(), s.end());
+    dr::line_index<buffer> index(gb1, 4);
+
+    std::string t = "x\ny\n";
+    gb1.replace(gb1.begin() + 2, gb1.begin() + 4, t.begin(), t.end());
+    s.replace(2, 2, t);
+    check(index, s);
+
+    std::string u = "\n\n\n";
+    std::vector<buffer::edit> edits{{0, 1, u}, {4, 2, {}}, {9, 0, u}};
+    gb1.apply_edits(edits);
+    s = std::string(gb1.begin(), gb1.end());
+    check(index, s);
+    CHECK(s == "\n\n\n\nx\nc\nd\n\n\n\n");
+
+    buffer gb2{'p', '\n', 'q'};
+    gb1.swap(gb2);
+    check(index, "p\nq");
+    gb1 = buffer{'r'};
+    check(index, "r");
+  }
+}
+
+TEST_CASE("Content hash follows edits", "[content_hash]") {
+  using buffer = dr::gap_buffer<char>;
+
+  auto check = [](const dr::content_hash<buffer>& hash, const buffer& gb) {
+    dr::content_hash<buffer> fresh(const_cast<buffer&>(gb), 5);
+    CHECK(hash.size() == gb.size());
+    CHECK(hash.value() == fresh.value());
+    CHECK(hash.value() == dr::content_hash_of(gb.begin(), gb.end()));
+  };
+
+  SECTION("Random edits") {
+    std::string s = "the quick brown fox";
+    buffer gb1(s.begin(), s.end());
+    dr::content_hash<buffer> hash(gb1, 8);
+    check(hash, gb1);
+
+    std::mt19937 rng(25);
+    for (int round = 0; round < 300; ++round) {
+      std::size_t pos = rng() % (gb1.size() + 1);
+      if (rng() % 3 == 0 && pos < gb1.size()) {
+        std::size_t n = std::min<std::size_t>(rng() % 40, gb1.size() - pos);
+        gb1.erase(gb1.begin() + pos, gb1.begin() + pos + n);
+      }
+      else {
+        std::string text;
+        for (std::size_t n = rng() % 30; n > 0; --n) text.push_back("ab\0"[rng() % 3]);
+        gb1.insert(gb1.begin() + pos, text.begin(), text.end());
+      }
+      check(hash, gb1);
+    }
+
+    std::string t(gb1.begin(), gb1.end());
+    gb1.replace(gb1.begin(), gb1.end(), t.rbegin(), t.rend());
+    check(hash, gb1);
+    gb1.clear();
+    check(hash, gb1);
+  }
+
+  SECTION("Batches of edits") {
+    std::string s = "abcdefghijklmnopqrstuvwxyz";
+    buffer gb1(s.begin(), s.end());
+    dr::content_hash<buffer> hash(gb1, 64);
+    std::vector<buffer::edit> edits{{2, 3, {}}, {10, 4, {}}};
+    gb1.apply_edits(edits);
+    CHECK(std::string(gb1.begin(), gb1.end()) == "abfghijopqrstuvwxyz");
+    check(hash, gb1);
+
+    // as much inserted as erased on average, so the buffer stays small
+    std::mt19937 rng(26);
+    std::string texts[] = {"", "x", "foo", "longer"};
+    dr::content_hash<buffer> small_blocks(gb1, 4);
+    for (int round = 0; round < 100; ++round) {
+      std::vector<buffer::edit> batch;
+      for (std::size_t pos = rng() % 5; pos < gb1.size(); pos += 1 + rng() % 12) {
+        std::size_t n = std::min<std::size_t>(rng() % 6, gb1.size() - pos);
+        batch.push_back({pos, n, texts[rng() % 4]});
+        pos += n;
+      }
+      if (round % 3 == 0) gb1.shrink_to_fit();
+      gb1.apply_edits(batch);
+      check(hash, gb1);
+      check(small_blocks, gb1);
+    }
+  }
+
+  SECTION("Equal contents hash equal") {
+    std::string s = "abcdefghijklmnopqrstuvwxyz";
+    buffer gb1(s.begin(), s.end()), gb2;
+    dr::content_hash<buffer> h1(gb1, 4), h2(gb2, 3);
+    CHECK(!h1.equals(h2));
+
+    // built in a different order, with the gap somewhere else
+    gb2.insert(gb2.end(), s.begin() + 13, s.end());
+    gb2.insert(gb2.begin(), s.begin(), s.begin() + 13);
+    CHECK(h1.value() == h2.value());
+    CHECK(h1.equals(h2));
+
+    gb2[5] = 'F';
+    h2.reset(gb2);
+    CHECK(h1.value() != h2.value());
+    CHECK(!h1.equals(h2));
+
+    // leading zeros and the length are part of the hash
+    buffer z1{'\0', 'a'}, z2{'a'};
+    CHECK(dr::content_hash_of(z1.begin(), z1.end()) != dr::content_hash_of(z2.begin(), z2.end()));
+
+    gb1.swap(gb2);
+    CHECK(h1.value() == dr::content_hash_of(gb1.begin(), gb1.end()));
+    CHECK(h2.value() == dr::content_hash_of(gb2.begin(), gb2.end()));
+  }
+
+  SECTION("Other value types") {
+    dr::gap_buffer<std::string> gb1{"one", "two", "three"};
+    dr::content_hash<dr::gap_buffer<std::string>> hash(gb1, 2);
+    gb1.insert(gb1.begin() + 1, {"four", "five", "six"});
+    gb1.erase(gb1.begin() + 3);
+    dr::gap_buffer<std::string> gb2{"one", "four", "five", "two", "three"};
+    CHECK(hash.value() == dr::content_hash_of(gb2.begin(), gb2.end()));
+    CHECK(hash.value() != dr::content_hash_of(gb2.begin(), gb2.end() - 1));
+  }
+}
+
+TEST_CASE("Markers follow edits", "[marker_set]") {
+  using buffer = dr::gap_buffer<char>;
+  using markers = dr::marker_set<buffer>;
+
+  std::string s(100, '.');
+  buffer gb1(s.begin(), s.end());
+  markers set(gb1);
+
+  SECTION("Gravity") {
+    auto left = set.create(10, markers::gravity::left);
+    auto right = set.create(10, markers::gravity::right);
+    auto after = set.create(20);
+    std::string abc = "abc";
+    gb1.insert(gb1.begin() + 10, abc.begin(), abc.end());
+    CHECK(set.position(left) == 10);
+    CHECK(set.position(right) == 13);
+    CHECK(set.position(after) == 23);
+
+    gb1.erase(gb1.begin() + 5, gb1.begin() + 15);
+    CHECK(set.position(left) == 5);
+    CHECK(set.position(right) == 5);
+    CHECK(set.position(after) == 13);
+
+    gb1.insert(gb1.begin() + 5, 'x');
+    CHECK(set.position(left) == 5);
+    CHECK(set.position(right) == 6);
+
+    set.move(left, 50);
+    set.release(after);
+    CHECK(set.size() == 2);
+    CHECK(set.position(left) == 50);
+    gb1 = buffer{'a', 'b'};
+    CHECK(set.position(left) == 2);
+    CHECK(set.position(right) == 2);
+  }
+
+  SECTION("Random edits agree with a plain list") {
+    struct model_marker { std::size_t pos; markers::gravity g; markers::marker m; bool live; };
+    std::vector<model_marker> model;
+    std::mt19937 rng(13);
+
+    for (int round = 0; round < 2000; ++round) {
+      std::size_t size = gb1.size();
+      std::size_t pos = rng() % (size + 1);
+      switch (rng() % 6) {
+      case 0: {
+        auto g = rng() % 2 ? markers::gravity::left : markers::gravity::right;
+        model.push_back({pos, g, set.create(pos, g), true});
+        break;
+      }
+      case 1:
+        if (!model.empty()) {
+          auto& mm = model[rng() % model.size()];
+          if (mm.live) {
+            set.release(mm.m);
+            mm.live = false;
+          }
+        }
+        break;
+      case 2: case 3: {
+        std::size_t n = 1 + rng() % 5;
+        gb1.insert(gb1.begin() + pos, n, 'x');
+        for (auto& mm : model)
+          if (mm.pos > pos || (mm.pos == pos && mm.g == markers::gravity::right)) mm.pos += n;
+        break;
+      }
+      default: {
+        std::size_t n = std::min<std::size_t>(rng() % 8, size - pos);
+        gb1.erase(gb1.begin() + pos, gb1.begin() + pos + n);
+        for (auto& mm : model)
+          if (mm.pos >= pos + n) mm.pos -= n;
+          else if (mm.pos > pos) mm.pos = pos;
+      }
+      }
+
+      for (const auto& mm : model)
+        if (mm.live) REQUIRE(set.position(mm.m) == mm.pos);
+    }
+  }
+}
+
+TEST_CASE("Edit journal undoes and redoes", "[edit_journal]") {
+  using buffer = dr::gap_buffer<char>;
+  using journal = dr::edit_journal<buffer>;
+  auto str = [](const buffer& gb) { return std::string(gb.begin(), gb.end()); };
+
+  std::string s = "hello world";
+  buffer gb1(s.begin(), s.end());
+
+  SECTION("Typing and deleting coalesce") {
+    journal j(gb1);
+    std::size_t cursor = 5;
+    for (char c : std::string(", dear")) gb1.insert(gb1.begin() + cursor++, c);
+    CHECK(str(gb1) == "hello, dear world");
+    gb1.erase(gb1.begin() + 10);
+    gb1.erase(gb1.begin() + 9);
+    gb1.erase(gb1.begin() + 8);
+    CHECK(str(gb1) == "hello, d world");
+
+    CHECK(j.undo());
+    CHECK(str(gb1) == "hello, dear world");
+    CHECK(j.undo());
+    CHECK(str(gb1) == "hello world");
+    CHECK_FALSE(j.undo());
+    CHECK(j.redo());
+    CHECK(j.redo());
+    CHECK(str(gb1) == "hello, d world");
+    CHECK_FALSE(j.redo());
+
+    j.undo();
+    gb1.insert(gb1.begin(), '>');
+    CHECK_FALSE(j.can_redo());
+    j.undo();
+    j.undo();
+    CHECK(str(gb1) == "hello world");
+  }
+
+  SECTION("Groups and seals") {
+    journal j(gb1);
+    std::string there = "there";
+    j.begin_group();
+    gb1.replace(gb1.begin() + 6, gb1.end(), there.begin(), there.end());
+    j.end_group();
+    gb1.push_back('!');
+    j.seal();
+    gb1.push_back('!');
+    CHECK(str(gb1) == "hello there!!");
+
+    j.undo();
+    CHECK(str(gb1) == "hello there!");
+    j.undo();
+    CHECK(str(gb1) == "hello there");
+    j.undo();
+    CHECK(str(gb1) == "hello world");
+    j.redo();
+    CHECK(str(gb1) == "hello there");
+  }
+
+  SECTION("Memory limit forgets the oldest steps") {
+    journal j(gb1, 4096);
+    std::string chunk(1000, 'x');
+    for (int i = 0; i < 10; ++i) {
+      gb1.insert(gb1.begin(), chunk.begin(), chunk.end());
+      j.seal();
+    }
+    CHECK(j.memory_used() <= 4096);
+    int steps = 0;
+    while (j.undo()) ++steps;
+    CHECK(steps >= 2);
+    CHECK(steps < 10);
+    CHECK(gb1.size() == std::size_t(11 + 1000 * (10 - steps)));
+  }
+
+  SECTION("Random edits undo back to the start") {
+    journal j(gb1, journal::default_memory_limit, 8);
+    dr::line_index<buffer> index(gb1, 4);
+    std::vector<std::string> history{str(gb1)};
+    std::mt19937 rng(14);
+    for (int round = 0; round < 500; ++round) {
+      std::size_t pos = rng() % (gb1.size() + 1);
+      if (rng() % 2 && pos < gb1.size())
+        gb1.erase(gb1.begin() + pos, gb1.begin() + std::min(gb1.size(), pos + 1 + rng() % 3));
+      else
+        gb1.insert(gb1.begin() + pos, 1 + rng() % 3, "ab\n"[rng() % 3]);
+      if (rng() % 5 == 0) j.seal();
+    }
+    std::string last = str(gb1);
+
+    while (j.undo()) { }
+    CHECK(str(gb1) == s);
+    CHECK(index.line_count() == 1);
+    while (j.redo()) { }
+    CHECK(str(gb1) == last);
+    CHECK(index.line_count() == std::size_t(std::count(last.begin(), last.end(), '\n')) + 1);
+  }
+}
+
+TEST_CASE("Chunked gapbuffer", "[chunked_gap_buffer]") {
+  using chunked = dr::chunked_gap_buffer<char, std::allocator<char>, 8, 4>;
+
+  SECTION("Basic operations") {
+    chunked cb1{'a', 'b', 'c'};
+    CHECK(cb1.size() == 3);
+    CHECK(cb1[1] == 'b');
+
+    std::string s("0123456789abcdefghijklmnopqrstuvwxyz");
+    cb1.insert(cb1.begin() + 1, s.begin(), s.end());
+    CHECK(cb1.size() == 39);
+    CHECK(cb1.height() > 0);
+    CHECK(std::string(cb1.begin(), cb1.end()) == "a" + s + "bc");
+    CHECK(std::string(cb1.rbegin(), cb1.rend()) == std::string(cb1.rbegin(), cb1.rend()));
+
+    chunked cb2(cb1);
+    CHECK(cb2 == cb1);
+    cb2.erase(cb2.begin() + 2, cb2.end() - 2);
+    CHECK(std::string(cb2.begin(), cb2.end()) == "a0bc");
+    CHECK(cb1 < cb2);
+    CHECK(cb2.height() < cb1.height());
+
+    std::string segments;
+    cb1.for_each_segment([&](auto span) { segments.append(span.begin(), span.end()); });
+    CHECK(segments == "a" + s + "bc");
+
+    cb1.clear();
+    CHECK(cb1.empty());
+  }
+
+  SECTION("Random edits agree with std::string") {
+    std::mt19937 rng(7);
+    chunked cb1;
+    std::string expected;
+    for (int i = 0; i < 3000; ++i) {
+      auto pos = std::uniform_int_distribution<std::size_t>(0, expected.size())(rng);
+      if (rng() % 3 != 0 || expected.empty()) {
+        std::string text(rng() % 20, char('a' + rng() % 26));
+        cb1.insert(cb1.begin() + pos, text.begin(), text.end());
+        expected.insert(pos, text);
+      }
+      else {
+        auto n = std::min<std::size_t>(rng() % 30, expected.size() - pos);
+        cb1.erase(cb1.begin() + pos, cb1.begin() + pos + n);
+        expected.erase(pos, n);
+      }
+      REQUIRE(cb1.size() == expected.size());
+    }
+    CHECK(std::string(cb1.begin(), cb1.end()) == expected);
+    for (std::size_t i = 0; i < expected.size(); i += 7) REQUIRE(cb1[i] == expected[i]);
+  }
+
+  SECTION("Nodes and leaves come from the allocator") {
+    using pmr_chunked = dr::chunked_gap_buffer<char, std::pmr::polymorphic_allocator<char>, 8, 4>;
+    dr::pmr::gap_buffer_arena arena;
+    // anything falling back to the default resource throws
+    auto* previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+    {
+      std::string s(200, 'x');
+      pmr_chunked cb1(s.begin(), s.end(), &arena);
+      CHECK(cb1.get_allocator().resource() == &arena);
+      CHECK(cb1.height() > 0);
+
+      pmr_chunked cb2(cb1);
+      auto snap = cb1.snapshot();
+      cb1.erase(cb1.begin() + 10, cb1.begin() + 150);
+      cb2.insert(cb2.begin() + 100, s.begin(), s.end());
+      CHECK(cb2.get_allocator().resource() == &arena);
+      CHECK(snap->get_allocator().resource() == &arena);
+
+      pmr_chunked cb3(std::move(cb2));
+      CHECK(cb3.size() == 400);
+      auto sub = cb3.substr(cb3.begin() + 50, cb3.begin() + 350);
+      CHECK(sub.get_allocator().resource() == &arena);
+      CHECK(std::string(sub.begin(), sub.end()) == std::string(cb3.begin() + 50, cb3.begin() + 350));
+      cb1.clear();
+      cb1.assign(s.begin(), s.end());
+      CHECK(std::string(cb1.begin(), cb1.end()) == s);
+    }
+    std::pmr::set_default_resource(previous);
+    CHECK(arena.reserved() > 0);
+  }
+}
+
+TEST_CASE("Chunked gapbuffer snapshots", "[chunked_gap_buffer]") {
+  using chunked = dr::chunked_gap_buffer<char, std::allocator<char>, 8, 4>;
+  auto str = [](const chunked& cb) { return std::string(cb.begin(), cb.end()); };
+
+  std::string s("0123456789abcdefghijklmnopqrstuvwxyz");
+  chunked cb1(s.begin(), s.end());
+
+  SECTION("Copies are independent") {
+    chunked cb2(cb1);
+    auto snap = cb1.snapshot();
+    cb1.erase(cb1.begin() + 3, cb1.begin() + 20);
+    cb1[0] = 'X';
+    *(cb1.begin() + 1) = 'Y';
+    cb2.insert(cb2.begin() + 5, 'Z');
+
+    CHECK(str(cb1) == "XY2klmnopqrstuvwxyz");
+    CHECK(str(cb2) == "01234Z56789abcdefghijklmnopqrstuvwxyz");
+    CHECK(str(*snap) == s);
+
+    // an iterator which cached its leaf before the copy writes to a fresh one
+    auto it = cb1.begin() + 2;
+    CHECK(*it == '2');
+    chunked cb3 = cb1;
+    *it = 'W';
+    CHECK(cb1[2] == 'W');
+    CHECK(cb3[2] == '2');
+  }
+
+  SECTION("Readers on other threads see a fixed state") {
+    std::atomic<bool> failed{false};
+    std::vector<std::thread> readers;
+    std::string expected = s;
+    for (int round = 0; round < 200; ++round) {
+      auto snap = cb1.snapshot();
+      if (round % 20 == 0) {
+        readers.emplace_back([snap, expected, &failed, str] {
+          for (int i = 0; i < 20; ++i)
+            if (str(*snap) != expected) failed = true;
+        });
+      }
+      std::size_t pos = round % (expected.size() + 1);
+      cb1.insert(cb1.begin() + pos, char('A' + round % 26));
+      expected.insert(expected.begin() + pos, char('A' + round % 26));
+      if (round % 3 == 0) {
+        cb1.erase(cb1.begin() + pos / 2);
+        expected.erase(pos / 2, 1);
+      }
+    }
+    for (auto& t : readers) t.join();
+    CHECK_FALSE(failed);
+    CHECK(str(cb1) == expected);
+  }
+}
+
+TEST_CASE("Concurrent buffer", "[concurrent_buffer]") {
+  using buffer = dr::concurrent_buffer<char, std::allocator<char>, 8, 4>;
+  auto str = [](const buffer::buffer_type& cb) { return std::string(cb.begin(), cb.end()); };
+
+  SECTION("Readers see the last published version") {
+    std::string s("hello world");
+    buffer cb(s.begin(), s.end(), 2);
+    auto r1 = cb.make_reader();
+    auto r2 = cb.make_reader();
+    CHECK_THROWS_AS(cb.make_reader(), std::length_error);
+
+    {
+      auto v = r1.read();
+      cb.edit().erase(cb.edit().begin() + 5, cb.edit().end());
+      CHECK(str(*v) == s);
+      cb.publish();
+      CHECK(str(*v) == s);
+      CHECK(str(*r2.read()) == "hello");
+      CHECK(cb.pending() == 1);
+    }
+    cb.update([](auto& b) { b.insert(b.end(), '!'); });
+    CHECK(cb.pending() == 0);
+    CHECK(str(*r1.read()) == "hello!");
+
+    // a released slot can be registered again
+    { auto moved = std::move(r2); }
+    auto r3 = cb.make_reader();
+    CHECK(r3.read()->size() == 6);
+  }
+
+  SECTION("Readers race with a writer") {
+    // the writer keeps the contents sorted and never shrinks them; readers
+    // check every version they get
+    buffer cb(8);
+    std::atomic<bool> done{false};
+    std::atomic<bool> failed{false};
+    std::atomic<long> reads{0};
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+      readers.emplace_back([&] {
+        auto r = cb.make_reader();
+        std::size_t last_size = 0;
+        while (!done) {
+          auto v = r.read();
+          if (!std::is_sorted(v->begin(), v->end())) failed = true;
+          if (v->size() < last_size) failed = true;
+          last_size = v->size();
+          ++reads;
+        }
+      });
+    }
+
+    std::mt19937 rng(5);
+    std::string expected;
+    for (int round = 0; round < 3000; ++round) {
+      auto& b = cb.edit();
+      char c = char('a' + rng() % 26);
+      auto pos = std::lower_bound(expected.begin(), expected.end(), c) - expected.begin();
+      b.insert(b.begin() + pos, c);
+      expected.insert(expected.begin() + pos, c);
+      if (round % 3 == 0) {
+        std::size_t victim = rng() % expected.size();
+        b.erase(b.begin() + victim);
+        expected.erase(victim, 1);
+      }
+      cb.publish();
+    }
+    while (reads < 1000) std::this_thread::yield();
+    done = true;
+    for (auto& t : readers) t.join();
+
+    CHECK_FALSE(failed);
+    CHECK(str(cb.edit()) == expected);
+    cb.publish();
+    CHECK(cb.pending() == 0);
+  }
+}
+
+TEST_CASE("Parallel algorithms", "[parallel]") {
+  dr::thread_pool pool(4);
+
+  // several chunks, with the gap inside one of them
+  std::string s;
+  std::mt19937 rng(3);
+  for (std::size_t i = 0; i < 3 * dr::parallel::chunk_bytes + 1000; ++i) s.push_back(char('a' + rng() % 26));
+  dr::gap_buffer<char> gb(s.begin(), s.end());
+  gb.insert(gb.begin() + std::ptrdiff_t(dr::parallel::chunk_bytes + 17), 'Q');
+  s.insert(s.begin() + std::ptrdiff_t(dr::parallel::chunk_bytes + 17), 'Q');
+
+  SECTION("Counting") {
+    CHECK(dr::parallel::count(gb.begin(), gb.end(), 'e', pool) == std::count(s.begin(), s.end(), 'e'));
+    auto vowel = [](char c) { return c == 'a' || c == 'e' || c == 'i' || c == 'o' || c == 'u'; };
+    CHECK(dr::parallel::count_if(gb.begin(), gb.end(), vowel, pool) == std::count_if(s.begin(), s.end(), vowel));
+  }
+
+  SECTION("Transform and copy") {
+    auto upper = [](char c) { return char(c - 'a' + 'A'); };
+    std::string out(s.size(), ' ');
+    dr::parallel::transform(gb.cbegin(), gb.cend(), out.begin(), [](char c) { return c; }, pool);
+    CHECK(out == s);
+
+    dr::parallel::transform(gb.begin() + 10, gb.end(), gb.begin() + 10, upper, pool);
+    std::transform(s.begin() + 10, s.end(), s.begin() + 10, upper);
+    CHECK(std::string(gb.begin(), gb.end()) == s);
+
+    std::vector<char> v(s.size());
+    CHECK(dr::parallel::copy(gb.cbegin(), gb.cend(), v.begin(), pool) == v.end());
+    CHECK(std::string(v.begin(), v.end()) == s);
+
+    auto sub = dr::parallel::substr(gb, gb.cbegin() + 5, gb.cend() - 5, pool);
+    CHECK(std::string(sub.begin(), sub.end()) == s.substr(5, s.size() - 10));
+  }
+
+  SECTION("Equality and hashing do not depend on the gap") {
+    dr::gap_buffer<char> other(s.begin(), s.end());
+    other.insert(other.begin() + 3, 'x');
+    other.erase(other.begin() + 3);
+    CHECK(dr::parallel::equal(gb, other, pool));
+    CHECK(dr::parallel::hash(gb.begin(), gb.end(), pool) == dr::parallel::hash(other.begin(), other.end(), pool));
+    CHECK(dr::parallel::hash(gb.begin() + 1, gb.end(), pool) != dr::parallel::hash(gb.begin(), gb.end(), pool));
+
+    other[other.size() - 1] = '#';
+    CHECK_FALSE(dr::parallel::equal(gb, other, pool));
+    CHECK(dr::parallel::hash(gb.begin(), gb.end(), pool) != dr::parallel::hash(other.begin(), other.end(), pool));
+    other.pop_back();
+    CHECK_FALSE(dr::parallel::equal(gb, other, pool));
+  }
+
+  SECTION("Exceptions reach the caller") {
+    std::atomic<int> calls{0};
+    CHECK_THROWS_AS(pool.parallel_for(100, [&](std::size_t i) {
+      ++calls;
+      if (i == 7) throw std::runtime_error("seven");
+    }), std::runtime_error);
+    CHECK(calls <= 100);
+
+    // the pool still works
+    std::vector<int> seen(1000);
+    pool.parallel_for(seen.size(), [&](std::size_t i) { seen[i]++; });
+    CHECK(std::count(seen.begin(), seen.end(), 1) == 1000);
+  }
+
+  SECTION("Loops nested in a loop run inline") {
+    std::vector<std::size_t> counts(8);
+    std::vector<std::ptrdiff_t> es(8);
+    pool.parallel_for(counts.size(), [&](std::size_t i) {
+      pool.parallel_for(10, [&](std::size_t) { ++counts[i]; });
+      es[i] = dr::parallel::count(gb.begin(), gb.end(), 'e', pool);
+    });
+    CHECK(std::count(counts.begin(), counts.end(), 10) == 8);
+    CHECK(std::count(es.begin(), es.end(), std::count(s.begin(), s.end(), 'e')) == 8);
+  }
+}
+
+TEST_CASE("Small gapbuffer keeps short contents inline", "[gapbuffer]") {
+  using small_buffer = dr::small_gap_buffer<char, 16>;
+
+  auto is_inline = [](const small_buffer& gb) {
+    auto p = reinterpret_cast<const char*>(gb.segments().first.data());
+    auto self = reinterpret_cast<const char*>(&gb);
+    return p >= self && p < self + sizeof(gb);
+  };
+
+  SECTION("Spill to the heap and back") {
+    small_buffer gb1{'a', 'b', 'c'};
+    CHECK(gb1.capacity() == 16);
+    CHECK(is_inline(gb1));
+
+    std::string s(20, 'x');
+    gb1.insert(gb1.begin() + 1, s.begin(), s.end());
+    CHECK_FALSE(is_inline(gb1));
+    CHECK(std::string(gb1.begin(), gb1.end()) == "a" + s + "bc");
+
+    gb1.erase(gb1.begin() + 1, gb1.begin() + 21);
+    gb1.shrink_to_fit();
+    CHECK(is_inline(gb1));
+    CHECK(std::string(gb1.begin(), gb1.end()) == "abc");
+  }
+
+  SECTION("Swap and move") {
+    small_buffer gb1{'a', 'b', 'c'};
+    small_buffer gb2{'d', 'e'};
+    gb1.insert(gb1.begin() + 1, 'x');
+    swap(gb1, gb2);
+    CHECK(std::string(gb1.begin(), gb1.end()) == "de");
+    CHECK(std::string(gb2.begin(), gb2.end()) == "axbc");
+    CHECK(is_inline(gb1));
+    CHECK(is_inline(gb2));
+
+    std::string s(40, 'y');
+    small_buffer gb3(s.begin(), s.end());
+    CHECK_FALSE(is_inline(gb3));
+    gb1.swap(gb3);
+    CHECK(std::string(gb1.begin(), gb1.end()) == s);
+    CHECK(std::string(gb3.begin(), gb3.end()) == "de");
+    CHECK(is_inline(gb3));
+
+    small_buffer gb4(std::move(gb2));
+    CHECK(std::string(gb4.begin(), gb4.end()) == "axbc");
+    CHECK(is_inline(gb4));
+    CHECK(gb2.empty());
+    gb4 = std::move(gb1);
+    CHECK(std::string(gb4.begin(), gb4.end()) == s);
+  }
+
+  SECTION("Non-trivial element type") {
+    dr::small_gap_buffer<std::string, 4> gb1{"a", "b"};
+    gb1.insert(gb1.begin() + 1, "x");
+    dr::small_gap_buffer<std::string, 4> gb2(std::move(gb1));
+    CHECK(gb2.size() == 3);
+    CHECK(gb2[1] == "x");
+    for (int i = 0; i < 10; ++i) gb2.insert(gb2.end(), std::to_string(i));
+    CHECK(gb2.size() == 13);
+    CHECK(gb2[12] == "9");
+    gb1 = gb2;
+    CHECK(gb1 == gb2);
+  }
+
+}
+
+TEST_CASE("Static gapbuffer", "[static_gap_buffer]") {
+  using line = dr::static_gap_buffer<char, 16>;
+
+  SECTION("Edits in a constant expression") {
+    constexpr auto edited = [] {
+      line b{'a', 'c', 'd'};
+      b.insert(b.begin() + 1, 'b');
+      b.erase(b.begin() + 3);
+      b.insert(b.end(), 3, 'x');
+      b.erase(b.begin());
+      return b;
+    }();
+    static_assert(edited.size() == 5);
+    static_assert(edited[0] == 'b' && edited[1] == 'c' && edited[4] == 'x');
+    static_assert(edited == line{'b', 'c', 'x', 'x', 'x'});
+    static_assert(std::is_trivially_copyable_v<line>);
+
+    constexpr std::array<char, 4> word{'w', 'o', 'r', 'd'};
+    static_assert(line(word).size() == 4);
+    static_assert(dr::static_gap_buffer<char, 32>(edited).size() == 5);
+  }
+
+  SECTION("Random edits against a string") {
+    std::mt19937 rng(7);
+    line b;
+    std::string s;
+    for (int i = 0; i < 5000; ++i) {
+      std::size_t offset = rng() % (s.size() + 1);
+      if (s.size() == b.capacity() || (!s.empty() && rng() % 2)) {
+        std::size_t n = std::min<std::size_t>(s.size() - std::min(offset, s.size() - 1), 1 + rng() % 3);
+        offset = std::min(offset, s.size() - n);
+        b.erase(b.begin() + std::ptrdiff_t(offset), b.begin() + std::ptrdiff_t(offset + n));
+        s.erase(offset, n);
+      }
+      else {
+        char c = char('a' + rng() % 26);
+        b.insert(b.begin() + std::ptrdiff_t(offset), c);
+        s.insert(s.begin() + std::ptrdiff_t(offset), c);
+      }
+      REQUIRE(std::string(b.begin(), b.end()) == s);
+    }
+
+    auto[front, back] = b.segments();
+    CHECK(front.size() + back.size() == s.size());
+    CHECK(dr::count(b.begin(), b.end(), s.empty() ? 'a' : s[0]) == std::count(s.begin(), s.end(), s.empty() ? 'a' : s[0]));
+  }
+
+  SECTION("Overflow policies") {
+    std::string s(20, 'y');
+    line b1{'a', 'b'};
+    CHECK_THROWS_AS(b1.insert(b1.begin() + 1, s.begin(), s.end()), std::length_error);
+    CHECK(std::string(b1.begin(), b1.end()) == "ab");
+    CHECK_FALSE(b1.try_insert(b1.begin(), s.begin(), s.end()));
+    CHECK(b1.try_insert(b1.begin(), s.begin(), s.begin() + 14));
+    CHECK(b1.full());
+    CHECK_FALSE(b1.try_push_back('z'));
+    CHECK_THROWS_AS(b1.push_back('z'), std::length_error);
+
+    dr::static_gap_buffer<char, 16, dr::truncate_on_overflow> b2{'a', 'b'};
+    b2.insert(b2.begin() + 1, s.begin(), s.end());
+    CHECK(b2.size() == 16);
+    CHECK(std::string(b2.begin(), b2.end()) == "a" + s.substr(0, 14) + "b");
+    b2.push_back('z');
+    CHECK(b2.back() == 'b');
+  }
+
+  SECTION("Framing with prepare and commit") {
+    line b{'h', 'd', 'r'};
+    auto gap = b.prepare(b.begin() + 1);
+    CHECK(gap.size() == 13);
+    gap[0] = '-';
+    gap[1] = '-';
+    b.commit(2);
+    CHECK(std::string(b.begin(), b.end()) == "h--dr");
+    CHECK(std::string(b.contiguous_view().begin(), b.contiguous_view().end()) == "h--dr");
+  }
+
+  SECTION("Non-trivial element type") {
+    dr::static_gap_buffer<std::string, 4> b{"a", "b"};
+    b.insert(b.begin() + 1, "x");
+    b.emplace(b.begin(), b[2]);
+    CHECK(b.size() == 4);
+    CHECK(b[0] == "b");
+    CHECK(b[2] == "x");
+    b.erase(b.begin() + 1, b.begin() + 3);
+    CHECK(b.size() == 2);
+    auto copy = b;
+    CHECK(copy == b);
+    CHECK_FALSE(b < copy);
+    b.push_back("c");
+    CHECK(copy < b);
+  }
+
+}